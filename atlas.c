@@ -0,0 +1,206 @@
+/*
+ * Copyright (C) 2003 Josh A. Beam
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "atlas.h"
+
+static struct atlas_page pages[MAX_ATLAS_PAGES];
+static int num_pages = 0;
+
+static int
+new_page()
+{
+	struct atlas_page *page;
+
+	if(num_pages == MAX_ATLAS_PAGES) {
+		fprintf(stderr, "Error: Lightmap atlas is full (%d pages)\n", MAX_ATLAS_PAGES);
+		return -1;
+	}
+
+	page = &pages[num_pages];
+	page->data = calloc(ATLAS_PAGE_SIZE * ATLAS_PAGE_SIZE * 3, 1);
+	if(!page->data) {
+		fprintf(stderr, "Error: Couldn't allocate memory for lightmap atlas\n");
+		return -1;
+	}
+
+	page->tex = 0;
+	page->shelf_x = page->shelf_y = page->shelf_height = 0;
+	memset(page->dirty_x0, 0, sizeof(page->dirty_x0));
+	memset(page->dirty_x1, 0, sizeof(page->dirty_x1));
+	page->dirty_min = ATLAS_PAGE_SIZE;
+	page->dirty_max = 0;
+
+	return num_pages++;
+}
+
+/* tries to place a rectangle in a page's current shelf, or a new one below it */
+static int
+page_alloc(struct atlas_page *page, unsigned int width, unsigned int height,
+           unsigned int *x, unsigned int *y)
+{
+	if(page->shelf_x + width > ATLAS_PAGE_SIZE || height > page->shelf_height) {
+		/* an empty shelf can grow to fit */
+		if(page->shelf_x == 0 && page->shelf_y + height <= ATLAS_PAGE_SIZE) {
+			page->shelf_height = height;
+		} else {
+			unsigned int next_y = page->shelf_y + page->shelf_height;
+
+			if(next_y + height > ATLAS_PAGE_SIZE)
+				return 0;
+			page->shelf_y = next_y;
+			page->shelf_x = 0;
+			page->shelf_height = height;
+		}
+	}
+
+	*x = page->shelf_x;
+	*y = page->shelf_y;
+	page->shelf_x += width;
+
+	return 1;
+}
+
+int
+atlas_alloc(unsigned int width, unsigned int height,
+            unsigned int *x, unsigned int *y)
+{
+	int i;
+
+	if(width > ATLAS_PAGE_SIZE || height > ATLAS_PAGE_SIZE) {
+		fprintf(stderr, "Error: %ux%u lightmap is larger than an atlas page\n", width, height);
+		return -1;
+	}
+
+	for(i = 0; i < num_pages; i++) {
+		if(page_alloc(&pages[i], width, height, x, y))
+			return i;
+	}
+
+	i = new_page();
+	if(i < 0)
+		return -1;
+	page_alloc(&pages[i], width, height, x, y);
+
+	return i;
+}
+
+int
+atlas_num_pages()
+{
+	return num_pages;
+}
+
+struct atlas_page *
+atlas_get_page(int page)
+{
+	if(page < 0 || page >= num_pages)
+		return NULL;
+
+	return &pages[page];
+}
+
+void
+atlas_mark_dirty(int page, unsigned int x, unsigned int y,
+                 unsigned int width, unsigned int height)
+{
+	struct atlas_page *p = atlas_get_page(page);
+	unsigned int row;
+
+	if(!p || width == 0 || height == 0)
+		return;
+
+	for(row = y; row < y + height; row++) {
+		if(p->dirty_x1[row] <= p->dirty_x0[row]) {
+			p->dirty_x0[row] = (unsigned short)x;
+			p->dirty_x1[row] = (unsigned short)(x + width);
+			continue;
+		}
+		if(x < p->dirty_x0[row])
+			p->dirty_x0[row] = (unsigned short)x;
+		if(x + width > p->dirty_x1[row])
+			p->dirty_x1[row] = (unsigned short)(x + width);
+	}
+
+	if(y < p->dirty_min)
+		p->dirty_min = y;
+	if(y + height > p->dirty_max)
+		p->dirty_max = y + height;
+}
+
+int
+atlas_next_dirty(const struct atlas_page *page, unsigned int *x, unsigned int *y,
+                 unsigned int *width, unsigned int *height)
+{
+	unsigned int row, x0, x1;
+
+	row = *y > page->dirty_min ? *y : page->dirty_min;
+	while(row < page->dirty_max && page->dirty_x1[row] <= page->dirty_x0[row])
+		row++;
+	if(row >= page->dirty_max)
+		return 0;
+
+	/* extend down while the next row's columns overlap the run's */
+	*y = row;
+	x0 = page->dirty_x0[row];
+	x1 = page->dirty_x1[row];
+	for(row++; row < page->dirty_max; row++) {
+		if(page->dirty_x1[row] <= x0 || page->dirty_x0[row] >= x1)
+			break;
+		if(page->dirty_x0[row] < x0)
+			x0 = page->dirty_x0[row];
+		if(page->dirty_x1[row] > x1)
+			x1 = page->dirty_x1[row];
+	}
+
+	*x = x0;
+	*width = x1 - x0;
+	*height = row - *y;
+
+	return 1;
+}
+
+void
+atlas_clear_dirty(struct atlas_page *page)
+{
+	unsigned int row;
+
+	for(row = page->dirty_min; row < page->dirty_max && row < ATLAS_PAGE_SIZE; row++)
+		page->dirty_x0[row] = page->dirty_x1[row] = 0;
+	page->dirty_min = ATLAS_PAGE_SIZE;
+	page->dirty_max = 0;
+}
+
+void
+atlas_shutdown()
+{
+	int i;
+
+	for(i = 0; i < num_pages; i++)
+		free(pages[i].data);
+	num_pages = 0;
+}
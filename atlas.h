@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2003 Josh A. Beam
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __ATLAS_H__
+#define __ATLAS_H__
+
+/*
+ * Lightmaps are packed into a few large pages rather than each getting
+ * its own texture, so the renderer can upload every changed lightmap in
+ * a page with one call and draw everything using a page in one batch.
+ */
+
+#define ATLAS_PAGE_SIZE		512
+#define MAX_ATLAS_PAGES		16
+
+struct atlas_page {
+	unsigned char *data;		/* ATLAS_PAGE_SIZE^2 RGB texels */
+	unsigned int tex;		/* GL texture name, 0 until first upload */
+
+	/* the page is filled in rows (shelves) from top to bottom */
+	unsigned int shelf_x, shelf_y, shelf_height;
+
+	/*
+	 * What has changed since the last upload: columns dirty_x0 to
+	 * dirty_x1 - 1 of each row, and the range of rows with any
+	 */
+	unsigned short dirty_x0[ATLAS_PAGE_SIZE], dirty_x1[ATLAS_PAGE_SIZE];
+	unsigned int dirty_min, dirty_max;
+};
+
+/*
+ * Finds room for a width x height rectangle. Returns the page it is in
+ * and stores its top left corner in x and y, or returns -1 if it won't
+ * fit.
+ */
+int atlas_alloc(unsigned int width, unsigned int height,
+                unsigned int *x, unsigned int *y);
+
+int atlas_num_pages();
+struct atlas_page *atlas_get_page(int page);
+
+/* marks a rectangle of a page as needing upload */
+void atlas_mark_dirty(int page, unsigned int x, unsigned int y,
+                      unsigned int width, unsigned int height);
+
+/*
+ * Finds the first run of dirty rows at or below *y whose columns
+ * overlap, and stores the rectangle covering it in x, y, width and
+ * height. Returns 0 if there are none. Calling it again with *y moved
+ * past the run finds the next.
+ */
+int atlas_next_dirty(const struct atlas_page *page, unsigned int *x, unsigned int *y,
+                     unsigned int *width, unsigned int *height);
+void atlas_clear_dirty(struct atlas_page *page);
+
+/* frees all pages; GL textures must be deleted by the caller */
+void atlas_shutdown();
+
+#endif /* __ATLAS_H__ */
@@ -0,0 +1,265 @@
+/*
+ * Copyright (C) 2003 Josh A. Beam
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bake.h"
+#include "light.h"
+#include "pool.h"
+#include "shadow.h"
+#include "my_endian.h"
+
+struct bake_cache_header {
+	char magic[4];
+	uint32_t version;
+	uint32_t key;			/* see cache_key() */
+	uint32_t num_surfaces;
+};
+
+/* followed by the surface's RGB lightmap->width x lightmap->height lightmap if size isn't 0 */
+struct bake_cache_surface {
+	uint32_t size;
+};
+
+/* both are written as they are, so their sizes are part of the format */
+typedef char bake_cache_header_size_check[sizeof(struct bake_cache_header) == 16 ? 1 : -1];
+typedef char bake_cache_surface_size_check[sizeof(struct bake_cache_surface) == 4 ? 1 : -1];
+
+static void
+hash_bytes(uint32_t *h, const void *data, size_t len)
+{
+	const unsigned char *p = data;
+
+	while(len--) {
+		*h ^= *p++;
+		*h *= 16777619UL;
+	}
+}
+
+static void
+hash_floats(uint32_t *h, const float *f, unsigned int n)
+{
+	float le;
+
+	while(n--) {
+		le = native_to_le_float(*f++);
+		hash_bytes(h, &le, sizeof(le));
+	}
+}
+
+/* FNV-1a hash of everything that goes into the baked lightmaps */
+static uint32_t
+cache_key(struct surface **surfaces, unsigned int num_surfaces)
+{
+	uint32_t h = 2166136261UL, size[2];
+	const struct light *light;
+	unsigned int i;
+	int id;
+
+	for(i = 0; i < num_surfaces; i++) {
+		hash_floats(&h, surfaces[i]->vertices[0], 12);
+		size[0] = native_to_le_uint(surfaces[i]->lightmap->width);
+		size[1] = native_to_le_uint(surfaces[i]->lightmap->height);
+		hash_bytes(&h, size, sizeof(size));
+	}
+
+	for(id = 0; id < light_max_id(); id++) {
+		if(!(light = light_get(id)) || !(light->flags & LIGHT_STATIC))
+			continue;
+
+		hash_floats(&h, light->pos, 3);
+		hash_floats(&h, light->color, 3);
+		hash_floats(&h, &light->radius, 1);
+	}
+
+	return h;
+}
+
+static unsigned int
+base_size(const struct surface *surf)
+{
+	return surf->lightmap->width * surf->lightmap->height * 3;
+}
+
+/*
+ * Finds the static lights reaching a surface and sets up its base
+ * lightmap for them, computing it if compute is set. Runs on the worker
+ * threads.
+ */
+static void
+bake_surface(void *arg, unsigned int index, unsigned int thread)
+{
+	struct surface *surf = ((struct surface **)arg)[index];
+	struct light lights[MAX_LIGHTS];
+	unsigned int i, num_lights;
+	float d;
+
+	free(surf->lightmap_base);
+	surf->lightmap_base = NULL;
+
+	num_lights = light_gather_static(surf, lights);
+	if(num_lights == 0)
+		return;
+
+	surf->static_dist_sq = surface_distance_sq(surf, lights[0].pos);
+	for(i = 1; i < num_lights; i++) {
+		if((d = surface_distance_sq(surf, lights[i].pos)) < surf->static_dist_sq)
+			surf->static_dist_sq = d;
+	}
+
+	surf->lightmap_base = malloc(base_size(surf));
+	if(!surf->lightmap_base) {
+		fprintf(stderr, "Error: Couldn't allocate memory for baked lightmap\n");
+		return;
+	}
+	shadow_compute(surf, lights, num_lights, surf->lightmap_base,
+	               surf->lightmap->width, surf->lightmap->height, surf->lightmap->width * 3, 0);
+}
+
+/* fills in the base lightmaps from the cache file; returns 0 if it doesn't match */
+static int
+read_cache(const char *filename, uint32_t key, struct surface **surfaces,
+           unsigned int num_surfaces)
+{
+	struct bake_cache_header header;
+	struct bake_cache_surface record;
+	struct light lights[MAX_LIGHTS];
+	unsigned int i, num_lights;
+	FILE *fp;
+	float d;
+
+	if(!(fp = fopen(filename, "rb")))
+		return 0;
+
+	if(fread(&header, sizeof(header), 1, fp) != 1 ||
+	   memcmp(header.magic, BAKE_CACHE_MAGIC, 4) != 0 ||
+	   le_to_native_uint(header.version) != BAKE_CACHE_VERSION ||
+	   le_to_native_uint(header.key) != key ||
+	   le_to_native_uint(header.num_surfaces) != num_surfaces) {
+		fclose(fp);
+		return 0;
+	}
+
+	for(i = 0; i < num_surfaces; i++) {
+		struct surface *surf = surfaces[i];
+
+		free(surf->lightmap_base);
+		surf->lightmap_base = NULL;
+
+		if(fread(&record, sizeof(record), 1, fp) != 1)
+			break;
+		if(le_to_native_uint(record.size) == 0)
+			continue;
+		if(le_to_native_uint(record.size) != base_size(surf) ||
+		   !(surf->lightmap_base = malloc(base_size(surf))) ||
+		   fread(surf->lightmap_base, base_size(surf), 1, fp) != 1)
+			break;
+
+		/* the distance is cheap enough to not be worth caching */
+		num_lights = light_gather_static(surf, lights);
+		surf->static_dist_sq = num_lights ? surface_distance_sq(surf, lights[0].pos) : 0.0f;
+		while(num_lights-- > 1) {
+			if((d = surface_distance_sq(surf, lights[num_lights].pos)) < surf->static_dist_sq)
+				surf->static_dist_sq = d;
+		}
+	}
+
+	fclose(fp);
+	return (i == num_surfaces);
+}
+
+static void
+write_cache(const char *filename, uint32_t key, struct surface **surfaces,
+            unsigned int num_surfaces)
+{
+	struct bake_cache_header header;
+	struct bake_cache_surface record;
+	unsigned int i;
+	FILE *fp;
+	int ok;
+
+	if(!(fp = fopen(filename, "wb"))) {
+		fprintf(stderr, "Warning: Couldn't open %s for writing\n", filename);
+		return;
+	}
+
+	memset(&header, 0, sizeof(header));
+	memset(&record, 0, sizeof(record));
+	memcpy(header.magic, BAKE_CACHE_MAGIC, 4);
+	header.version = native_to_le_uint(BAKE_CACHE_VERSION);
+	header.key = native_to_le_uint(key);
+	header.num_surfaces = native_to_le_uint(num_surfaces);
+	ok = (fwrite(&header, sizeof(header), 1, fp) == 1);
+
+	for(i = 0; i < num_surfaces && ok; i++) {
+		record.size = native_to_le_uint(surfaces[i]->lightmap_base ? base_size(surfaces[i]) : 0);
+		ok = (fwrite(&record, sizeof(record), 1, fp) == 1);
+		if(ok && surfaces[i]->lightmap_base)
+			ok = (fwrite(surfaces[i]->lightmap_base, base_size(surfaces[i]), 1, fp) == 1);
+	}
+
+	if(fclose(fp) != 0 || !ok) {
+		fprintf(stderr, "Warning: Couldn't write %s\n", filename);
+		remove(filename);
+	}
+}
+
+unsigned int
+bake_static_lights(struct surface **surfaces, unsigned int num_surfaces,
+                   const char *cache_file)
+{
+	unsigned int i, baked = 0;
+	int id, have_static = 0;
+	uint32_t key;
+
+	for(id = 0; id < light_max_id(); id++) {
+		if(light_get(id) && (light_get(id)->flags & LIGHT_STATIC))
+			have_static = 1;
+	}
+
+	/* nothing to bake, and no point in a cache file */
+	if(!have_static) {
+		for(i = 0; i < num_surfaces; i++) {
+			free(surfaces[i]->lightmap_base);
+			surfaces[i]->lightmap_base = NULL;
+		}
+		return 0;
+	}
+
+	key = cache_key(surfaces, num_surfaces);
+	if(!cache_file || !read_cache(cache_file, key, surfaces, num_surfaces)) {
+		pool_run(bake_surface, surfaces, num_surfaces);
+		if(cache_file)
+			write_cache(cache_file, key, surfaces, num_surfaces);
+	}
+
+	for(i = 0; i < num_surfaces; i++) {
+		if(surfaces[i]->lightmap_base)
+			baked++;
+	}
+
+	return baked;
+}
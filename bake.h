@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) 2003 Josh A. Beam
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __BAKE_H__
+#define __BAKE_H__
+
+#include "lightmap.h"
+
+/*
+ * Lights flagged LIGHT_STATIC are baked once into a base lightmap for
+ * each surface they reach, and only the other lights are computed every
+ * frame and added on top. Static lights are always baked with shadows,
+ * from whatever was given to shadow_init(), and mustn't be moved or
+ * changed after they've been baked.
+ *
+ * Baked lightmaps can be cached in a file, which is only used if it was
+ * written for the same surfaces, lightmap sizes and static lights.
+ */
+
+#define BAKE_CACHE_MAGIC	"DLMC"
+#define BAKE_CACHE_VERSION	2
+
+/*
+ * Bakes the static lights into surf->lightmap_base for each surface,
+ * which must already have its lightmap size set. The results are read
+ * from cache_file if it matches, and written to it otherwise; cache_file
+ * may be NULL to always bake. Returns the number of surfaces that have
+ * a base lightmap.
+ */
+unsigned int bake_static_lights(struct surface **surfaces, unsigned int num_surfaces,
+                                const char *cache_file);
+
+#endif /* __BAKE_H__ */
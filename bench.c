@@ -0,0 +1,384 @@
+/*
+ * Copyright (C) 2003 Josh A. Beam
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Headless benchmark for the lightmap code. It doesn't need a window or
+ * a GL implementation, so it can be run on build machines to catch
+ * performance regressions in the texel loop.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "lightmap.h"
+#include "light.h"
+#include "pool.h"
+#include "prof.h"
+#include "shadow.h"
+#include "surfpool.h"
+
+/* default lightmap size; the demo sizes them per surface instead */
+#ifndef LIGHTMAP_SIZE
+#define LIGHTMAP_SIZE	16
+#endif
+
+static float world_size = 20.0f;
+
+/*
+ * Lightmap sizes the kernels are also checked at: none are multiples of
+ * the vector width, so the scalar tails run, and some are a single row
+ * or column.
+ */
+static const unsigned int shape_sizes[][2] = {
+	{ 13, 7 }, { 33, 1 }, { 1, 33 }, { 7, 13 }, { 5, 3 }, { 17, 17 }
+};
+#define NUM_SHAPE_SIZES		(sizeof(shape_sizes) / sizeof(shape_sizes[0]))
+#define SHAPE_MAX_SIZE		33
+#define NUM_SHAPES		64	/* half with right angles, half skewed */
+
+/* turned and skewed surfaces near the lights, for checking the kernels */
+static struct surface_pool shape_pool;
+
+extern float bench_frand(float min, float max);
+extern void bench_random_surface(struct surface *surf, float world, float max_side);
+extern void bench_random_quad(float v[4][3], const float origin[3], float max_side, int skewed);
+extern int bench_pcx(int num_files, char *files[]);
+extern int bench_grid(int num_sizes, char *sizes[]);
+extern int bench_endian(int argc, char *argv[]);
+extern int bench_pool(int num_sizes, char *sizes[]);
+
+static void
+usage(const char *name)
+{
+	fprintf(stderr, "usage: %s [-s lightmap size] [-n surfaces] [-l lights] [-r rounds]\n"
+	                "       [-w world size] [-t threads] [-k auto|scalar|sse2|avx2|fixed|all] [-S]\n"
+	                "       %s -P [pcx files]\n"
+	                "       %s -G [surface counts]\n"
+	                "       %s -E [buffer megabytes]\n"
+	                "       %s -O [surface counts]\n", name, name, name, name, name);
+	exit(1);
+}
+
+/* builds the shapes, each with its first corner within a few units of a light */
+static int
+make_shapes()
+{
+	const struct light *light;
+	float v[4][3], origin[3];
+	unsigned int i, j;
+
+	if(!surfpool_init(&shape_pool, NUM_SHAPES) || surfpool_alloc(&shape_pool, NUM_SHAPES, NULL) < 0)
+		return 0;
+
+	for(i = 0; i < NUM_SHAPES; i++) {
+		light = light_get(i % light_max_id());
+		for(j = 0; j < 3; j++)
+			origin[j] = light->pos[j] + bench_frand(-3.0f, 3.0f);
+		bench_random_quad(v, origin, 6.0f, i % 2);
+		surface_init(&shape_pool.records[i], v);
+	}
+
+	return 1;
+}
+
+struct diff_stats {
+	unsigned long channels, mismatches, total_diff;
+	int max_diff;
+};
+
+/* computes a width x height lightmap with kernel k and the scalar one and adds up the differences */
+static void
+compare_kernel(int k, const struct surface *surf, unsigned int width, unsigned int height,
+               unsigned char *data, unsigned char *ref, struct diff_stats *st)
+{
+	struct light lights[MAX_LIGHTS];
+	unsigned int j, num_lights;
+	int diff;
+
+	num_lights = light_gather(surf, lights, NULL);
+	lightmap_set_kernel(LIGHTMAP_KERNEL_SCALAR);
+	lightmap_compute(surf, lights, num_lights, ref, width, height, width * 3);
+	lightmap_set_kernel(k);
+	lightmap_compute(surf, lights, num_lights, data, width, height, width * 3);
+
+	st->channels += width * height * 3;
+	for(j = 0; j < width * height * 3; j++) {
+		diff = abs((int)data[j] - (int)ref[j]);
+		if(diff) {
+			st->mismatches++;
+			st->total_diff += diff;
+			if(diff > st->max_diff)
+				st->max_diff = diff;
+		}
+	}
+}
+
+static void
+print_diff(const char *what, const struct diff_stats *st)
+{
+	printf("  max difference from scalar%s: %d LSB, %lu of %lu channels differ, %.3f LSB mean\n",
+	       what, st->max_diff, st->mismatches, st->channels,
+	       (double)st->total_diff / (double)st->channels);
+}
+
+/*
+ * Compares the output of the current kernel against the scalar reference
+ * for every surface, and for the shapes at each of shape_sizes, and
+ * prints the largest difference in any channel.
+ */
+static void
+verify_kernel(int k, struct surface *surfaces, unsigned int num_surfaces,
+              unsigned char *data, unsigned char *ref, unsigned int size)
+{
+	unsigned char shape_data[SHAPE_MAX_SIZE * SHAPE_MAX_SIZE * 3];
+	unsigned char shape_ref[SHAPE_MAX_SIZE * SHAPE_MAX_SIZE * 3];
+	struct diff_stats st, turned, skewed;
+	unsigned int i, j;
+
+	memset(&st, 0, sizeof(st));
+	for(i = 0; i < num_surfaces; i++)
+		compare_kernel(k, &surfaces[i], size, size, data, ref, &st);
+	print_diff("", &st);
+
+	memset(&turned, 0, sizeof(turned));
+	memset(&skewed, 0, sizeof(skewed));
+	for(j = 0; j < NUM_SHAPE_SIZES; j++) {
+		for(i = 0; i < NUM_SHAPES; i++) {
+			compare_kernel(k, &shape_pool.records[i], shape_sizes[j][0], shape_sizes[j][1],
+			               shape_data, shape_ref, i % 2 ? &skewed : &turned);
+		}
+	}
+	print_diff(", turned shapes", &turned);
+	print_diff(", skewed shapes", &skewed);
+}
+
+struct bench_job {
+	struct surface *surfaces;
+	unsigned int size;
+	int shadows;			/* cast shadow rays against the other surfaces */
+	unsigned char *buffers[MAX_POOL_THREADS];	/* one lightmap per thread */
+	unsigned char *samples;		/* one texel value per surface, for the checksum */
+	unsigned char *lit;		/* lights per surface after culling */
+};
+
+static void
+bench_surface(void *arg, unsigned int index, unsigned int thread)
+{
+	struct bench_job *job = arg;
+	struct light lights[MAX_LIGHTS];
+	unsigned char *data = job->buffers[thread];
+	unsigned int num_lights;
+
+	num_lights = light_gather(&job->surfaces[index], lights, NULL);
+	if(job->shadows)
+		shadow_compute(&job->surfaces[index], lights, num_lights, data,
+		               job->size, job->size, job->size * 3, 0);
+	else
+		lightmap_compute(&job->surfaces[index], lights, num_lights, data,
+		                 job->size, job->size, job->size * 3);
+
+	job->lit[index] = (unsigned char)num_lights;
+	job->samples[index] = data[(index * 7) % (job->size * job->size * 3)];
+}
+
+static void
+bench_kernel(int k, struct bench_job *job, unsigned int num_surfaces,
+             unsigned char *ref, unsigned int rounds)
+{
+	unsigned long lit = 0;
+	unsigned long checksum = 0;
+	double start, elapsed, texels;
+	unsigned int i, r, size = job->size;
+
+	k = lightmap_set_kernel(k);
+	printf("%s kernel, %d thread(s):\n", lightmap_kernel_name(k), pool_num_threads());
+
+	shadow_begin_frame();
+	start = prof_time();
+	for(r = 0; r < rounds; r++) {
+		pool_run(bench_surface, job, num_surfaces);
+		for(i = 0; i < num_surfaces; i++) {
+			lit += job->lit[i];
+			checksum = checksum * 31 + job->samples[i];
+		}
+	}
+	elapsed = prof_time() - start;
+
+	texels = (double)size * size * num_surfaces * rounds;
+	printf("  %.3f s, %.1f Mtexels/s, %.2f ns/texel (checksum %08lx)\n",
+	       elapsed, texels / elapsed / 1000000.0,
+	       elapsed * 1000000000.0 / texels, checksum & 0xffffffffUL);
+	printf("  %.2f lights per surface after culling\n",
+	       (double)lit / ((double)num_surfaces * rounds));
+	if(job->shadows) {
+		printf("  %.1f Mrays/s, %.2f shadow rays per texel\n",
+		       (double)shadow_rays_cast() / elapsed / 1000000.0,
+		       (double)shadow_rays_cast() / texels);
+	}
+
+	if(k != LIGHTMAP_KERNEL_SCALAR && !job->shadows)
+		verify_kernel(k, job->surfaces, num_surfaces, job->buffers[0], ref, size);
+}
+
+int
+main(int argc, char *argv[])
+{
+	unsigned int size = LIGHTMAP_SIZE;
+	unsigned int num_surfaces = 4096;
+	unsigned int num_lights = 1;
+	unsigned int rounds = 10;
+	const char *kernel = "auto";
+	int threads = 0, shadows = 0;
+	struct bench_job job;
+	struct surface_pool surface_pool;
+	struct surface *surfaces;
+	unsigned char *ref;
+	float pos[3], color[3];
+	unsigned int i, j;
+	double start;
+	int c, k;
+
+	while((c = getopt(argc, argv, "s:n:l:r:w:k:t:SPGEO")) != -1) {
+		switch(c) {
+			case 's':
+				size = atoi(optarg);
+				break;
+			case 'n':
+				num_surfaces = atoi(optarg);
+				break;
+			case 'l':
+				num_lights = atoi(optarg);
+				break;
+			case 'r':
+				rounds = atoi(optarg);
+				break;
+			case 'w':
+				world_size = atof(optarg);
+				break;
+			case 'k':
+				kernel = optarg;
+				break;
+			case 't':
+				threads = atoi(optarg);
+				break;
+			case 'S':
+				shadows = 1;
+				break;
+			case 'P':
+				return bench_pcx(argc - optind, argv + optind);
+			case 'G':
+				return bench_grid(argc - optind, argv + optind);
+			case 'E':
+				return bench_endian(argc - optind, argv + optind);
+			case 'O':
+				return bench_pool(argc - optind, argv + optind);
+			default:
+				usage(argv[0]);
+				break;
+		}
+	}
+	if(size < 1 || num_surfaces < 1 || rounds < 1 || num_lights > MAX_LIGHTS)
+		usage(argv[0]);
+
+	lightmap_set_kernel(LIGHTMAP_KERNEL_AUTO);
+	threads = pool_init(threads);
+
+	if(!surfpool_init(&surface_pool, num_surfaces) ||
+	   surfpool_alloc(&surface_pool, num_surfaces, NULL) < 0) {
+		fprintf(stderr, "Error: Couldn't allocate memory for benchmark\n");
+		return 1;
+	}
+	surfaces = surface_pool.records;
+	ref = malloc(size * size * 3);
+	job.surfaces = surfaces;
+	job.size = size;
+	job.shadows = shadows;
+	job.samples = malloc(num_surfaces);
+	job.lit = malloc(num_surfaces);
+	for(i = 0; i < (unsigned int)threads; i++) {
+		job.buffers[i] = malloc(size * size * 3);
+		if(!job.buffers[i])
+			ref = NULL;
+	}
+	if(!ref || !job.samples || !job.lit) {
+		fprintf(stderr, "Error: Couldn't allocate memory for benchmark\n");
+		return 1;
+	}
+
+	for(i = 0; i < num_surfaces; i++)
+		bench_random_surface(&surfaces[i], world_size, 8.0f);
+	if(shadows) {
+		struct surface **list = malloc(sizeof(struct surface *) * num_surfaces);
+
+		if(!list) {
+			fprintf(stderr, "Error: Couldn't allocate memory for benchmark\n");
+			return 1;
+		}
+		for(i = 0; i < num_surfaces; i++)
+			list[i] = &surfaces[i];
+		start = prof_time();
+		shadow_init(list, num_surfaces);
+		printf("shadows: hierarchy built in %.2f ms\n", (prof_time() - start) * 1000.0);
+		free(list);
+	}
+	for(i = 0; i < num_lights; i++) {
+		for(j = 0; j < 3; j++) {
+			pos[j] = bench_frand(-world_size * 0.5f, world_size * 0.5f);
+			color[j] = bench_frand(0.25f, 1.0f);
+		}
+		light_add(pos, color, 0.0f, 0);
+	}
+	if(!shadows && !make_shapes()) {
+		fprintf(stderr, "Error: Couldn't allocate memory for benchmark\n");
+		return 1;
+	}
+
+	printf("lightmap: %ux%u texels, %u surfaces, %u lights, %u rounds, %.0f unit world\n",
+	       size, size, num_surfaces, num_lights, rounds, world_size);
+
+	for(k = LIGHTMAP_KERNEL_AUTO; k < LIGHTMAP_NUM_KERNELS; k++) {
+		if(strcmp(kernel, "all") == 0) {
+			/* run each kernel once, skipping ones the CPU falls back from */
+			if(k == LIGHTMAP_KERNEL_AUTO || lightmap_set_kernel(k) != k)
+				continue;
+		} else if(strcmp(kernel, lightmap_kernel_name(k)) != 0) {
+			continue;
+		}
+
+		bench_kernel(k, &job, num_surfaces, ref, rounds);
+	}
+
+	shadow_shutdown();
+	pool_shutdown();
+	for(i = 0; i < (unsigned int)threads; i++)
+		free(job.buffers[i]);
+	free(job.lit);
+	free(job.samples);
+	free(ref);
+	surfpool_free(&shape_pool);
+	surfpool_free(&surface_pool);
+	return 0;
+}
@@ -0,0 +1,158 @@
+/*
+ * Copyright (C) 2003 Josh A. Beam
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Byte swapping benchmark. Converts a large buffer of each element type
+ * in place with the le_to_native_*_array() functions, which do nothing
+ * on little-endian hosts, with swap_16_array() and swap_32_array(),
+ * which is what a big-endian host pays, and one value at a time with
+ * the byte shuffle the single value functions used to do.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "my_endian.h"
+#include "prof.h"
+
+#define ENDIAN_DEFAULT_MB	64
+#define ENDIAN_ROUNDS		10
+
+static const char *type_names[] = { "short", "ushort", "int", "uint", "float" };
+static const unsigned int type_sizes[] = { 2, 2, 4, 4, 4 };
+
+/* the native conversion for each type, which the host's byte order may make free */
+static void
+convert(int type, void *data, unsigned long count)
+{
+	switch(type) {
+		case 0:
+			le_to_native_short_array((int16_t *)data, count);
+			break;
+		case 1:
+			le_to_native_ushort_array((uint16_t *)data, count);
+			break;
+		case 2:
+			le_to_native_int_array((int32_t *)data, count);
+			break;
+		case 3:
+			le_to_native_uint_array((uint32_t *)data, count);
+			break;
+		default:
+			le_to_native_float_array((float *)data, count);
+			break;
+	}
+}
+
+static void
+swap_bytewise(unsigned char *p, unsigned long count, unsigned int size)
+{
+	unsigned char tmp[4];
+	unsigned long i;
+	unsigned int j;
+
+	for(i = 0; i < count; i++, p += size) {
+		for(j = 0; j < size; j++)
+			tmp[j] = p[size - 1 - j];
+		for(j = 0; j < size; j++)
+			p[j] = tmp[j];
+	}
+}
+
+/* returns GB/s for rounds passes over the buffer with the given method */
+static double
+time_method(int method, int type, unsigned char *data, unsigned long bytes)
+{
+	unsigned long count = bytes / type_sizes[type];
+	double start;
+	int r;
+
+	start = prof_time();
+	for(r = 0; r < ENDIAN_ROUNDS; r++) {
+		if(method == 0)
+			convert(type, data, count);
+		else if(method == 1 && type_sizes[type] == 2)
+			swap_16_array(data, count);
+		else if(method == 1)
+			swap_32_array(data, count);
+		else
+			swap_bytewise(data, count, type_sizes[type]);
+	}
+
+	return (double)bytes * ENDIAN_ROUNDS / (prof_time() - start) / 1e9;
+}
+
+int
+bench_endian(int argc, char *argv[])
+{
+	unsigned long bytes, i;
+	unsigned char *data, *check;
+	int type, ok = 1;
+
+	bytes = (unsigned long)(argc > 0 ? atoi(argv[0]) : ENDIAN_DEFAULT_MB) << 20;
+	data = malloc(bytes);
+	check = malloc(bytes);
+	if(bytes == 0 || !data || !check) {
+		fprintf(stderr, "Error: Couldn't allocate memory for buffers\n");
+		return 1;
+	}
+
+	for(i = 0; i < bytes; i++)
+		data[i] = (unsigned char)(i * 2654435761UL >> 13);
+
+	printf("%s-endian host, %lu MB buffer, GB/s:\n",
+	       MY_BYTE_ORDER == MY_LITTLE_ENDIAN ? "little" :
+	       MY_BYTE_ORDER == MY_BIG_ENDIAN ? "big" : "unknown", bytes >> 20);
+	printf("  type     le_to_native      swap  bytewise\n");
+	for(type = 0; type < 5; type++) {
+		/* check the vector swap against the bytewise one */
+		memcpy(check, data, bytes);
+		if(type_sizes[type] == 2)
+			swap_16_array(check, bytes / 2);
+		else
+			swap_32_array(check, bytes / 4);
+		swap_bytewise(check, bytes / type_sizes[type], type_sizes[type]);
+		if(memcmp(check, data, bytes) != 0)
+			ok = 0;
+
+		printf("  %-8s ", type_names[type]);
+		if(MY_BYTE_ORDER == MY_LITTLE_ENDIAN)
+			printf("%12s", "no-op");
+		else
+			printf("%12.2f", time_method(0, type, data, bytes));
+		printf(" %9.2f %9.2f\n", time_method(1, type, data, bytes),
+		       time_method(2, type, data, bytes));
+	}
+
+	free(data);
+	free(check);
+
+	if(!ok) {
+		printf("Swapped buffers don't match\n");
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,163 @@
+/*
+ * Copyright (C) 2003 Josh A. Beam
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Light grid benchmark. For growing numbers of surfaces at the same
+ * density, times finding the surfaces within reach of each light with a
+ * linear scan and with the grid, and checks that both find the same.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "lightmap.h"
+#include "light.h"
+#include "lightgrid.h"
+#include "surfpool.h"
+#include "prof.h"
+
+#define GRID_LIGHTS		MAX_LIGHTS
+#define GRID_LIGHT_RADIUS	4.0f
+#define GRID_ROUNDS		10
+
+extern float bench_frand(float min, float max);
+extern void bench_random_surface(struct surface *surf, float world, float max_side);
+
+static void
+move_lights(float world)
+{
+	float pos[3];
+	int id;
+
+	for(id = 0; id < light_max_id(); id++) {
+		pos[0] = bench_frand(-world * 0.5f, world * 0.5f);
+		pos[1] = bench_frand(-world * 0.5f, world * 0.5f);
+		pos[2] = bench_frand(-world * 0.5f, world * 0.5f);
+		light_move(id, pos);
+	}
+}
+
+static int
+bench_grid_size(unsigned int num_surfaces)
+{
+	struct surface_pool pool;
+	struct surface **surfaces;
+	unsigned int *out, i, r, linear_found = 0, grid_found = 0;
+	double start, build, linear = 0.0, query = 0.0, update_all = 0.0, update_one = 0.0;
+	float world, color[3] = { 1.0f, 1.0f, 1.0f }, pos[3] = { 0.0f, 0.0f, 0.0f };
+	const struct light *light;
+	int id;
+
+	/* keep the same number of surfaces per unit of volume */
+	world = 20.0f * (float)pow((double)num_surfaces / 4096.0, 1.0 / 3.0);
+
+	surfaces = malloc(sizeof(struct surface *) * num_surfaces);
+	out = malloc(sizeof(unsigned int) * num_surfaces);
+	if(!surfaces || !out || !surfpool_init(&pool, num_surfaces) ||
+	   surfpool_alloc(&pool, num_surfaces, NULL) < 0) {
+		fprintf(stderr, "Error: Couldn't allocate memory for benchmark\n");
+		return 0;
+	}
+	for(i = 0; i < num_surfaces; i++) {
+		bench_random_surface(&pool.records[i], world, 4.0f);
+		surfaces[i] = &pool.records[i];
+	}
+	for(id = 0; id < GRID_LIGHTS; id++)
+		light_add(pos, color, GRID_LIGHT_RADIUS, 0);
+
+	start = prof_time();
+	lightgrid_build(surfaces, num_surfaces);
+	build = prof_time() - start;
+
+	for(r = 0; r < GRID_ROUNDS; r++) {
+		move_lights(world);
+
+		start = prof_time();
+		for(id = 0; id < light_max_id(); id++) {
+			light = light_get(id);
+			for(i = 0; i < num_surfaces; i++) {
+				if(surface_distance_sq(surfaces[i], light->pos) < GRID_LIGHT_RADIUS * GRID_LIGHT_RADIUS)
+					linear_found++;
+			}
+		}
+		linear += prof_time() - start;
+
+		start = prof_time();
+		for(id = 0; id < light_max_id(); id++)
+			grid_found += lightgrid_query(light_get(id)->pos, GRID_LIGHT_RADIUS, out, num_surfaces);
+		query += prof_time() - start;
+
+		/* every light has moved, so every light is looked up again */
+		start = prof_time();
+		lightgrid_update();
+		update_all += prof_time() - start;
+
+		/* only one light moves */
+		light = light_get(0);
+		pos[0] = light->pos[0] + 0.5f;
+		pos[1] = light->pos[1];
+		pos[2] = light->pos[2];
+		light_move(0, pos);
+		start = prof_time();
+		lightgrid_update();
+		update_one += prof_time() - start;
+	}
+
+	printf("%7u surfaces, %.0f unit world: %.1f surfaces per light, grid built in %.2f ms\n",
+	       num_surfaces, world, (double)linear_found / (GRID_ROUNDS * GRID_LIGHTS), build * 1000.0);
+	printf("  linear scan %8.3f ms, grid %7.3f ms (%.1fx) for %d lights\n",
+	       linear * 1000.0 / GRID_ROUNDS, query * 1000.0 / GRID_ROUNDS,
+	       query > 0.0 ? linear / query : 0.0, GRID_LIGHTS);
+	printf("  update after moving every light %.3f ms, one light %.3f ms\n",
+	       update_all * 1000.0 / GRID_ROUNDS, update_one * 1000.0 / GRID_ROUNDS);
+	if(grid_found != linear_found)
+		printf("  MISMATCH: grid found %u, linear scan %u\n", grid_found, linear_found);
+
+	lightgrid_free();
+	for(id = 0; id < GRID_LIGHTS; id++)
+		light_remove(id);
+	free(out);
+	free(surfaces);
+	surfpool_free(&pool);
+
+	return (grid_found == linear_found);
+}
+
+int
+bench_grid(int num_sizes, char *sizes[])
+{
+	static const unsigned int default_sizes[] = { 1000, 10000, 100000 };
+	int i, ok = 1;
+
+	if(num_sizes == 0) {
+		for(i = 0; i < (int)(sizeof(default_sizes) / sizeof(default_sizes[0])); i++)
+			ok &= bench_grid_size(default_sizes[i]);
+	} else {
+		for(i = 0; i < num_sizes; i++)
+			ok &= bench_grid_size((unsigned int)atoi(sizes[i]));
+	}
+
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,226 @@
+/*
+ * Copyright (C) 2003 Josh A. Beam
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * PCX decoding benchmark. Decodes each file given on the command line,
+ * or if there are none, a generated corpus of large 8-bit and 24-bit
+ * images whose decoded pixels are also checked.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "my_endian.h"
+#include "prof.h"
+
+extern unsigned char *read_pcx(const char *filename, unsigned int *widthp, unsigned int *heightp);
+extern unsigned char *read_pcx_mem(const unsigned char *buf, size_t size,
+                                   unsigned int *widthp, unsigned int *heightp);
+
+#define PCX_ROUNDS	5
+
+/* value of channel c (0-2, or 0 for palette indices) of a generated pixel */
+static unsigned char
+pattern(unsigned int x, unsigned int y, unsigned int c)
+{
+	/* blocks of flat color so there are runs to encode, with some noise */
+	unsigned int v = (x / 16) * 37 + (y / 16) * 11 + c * 85;
+
+	if(((x * 7 + y * 13) & 31) == 0)
+		v ^= x * y;
+
+	return (unsigned char)v;
+}
+
+static unsigned char *
+encode_run(unsigned char *out, unsigned char byte, unsigned int count)
+{
+	while(count > 0) {
+		unsigned int n = count > 63 ? 63 : count;
+
+		if(n == 1 && (byte & 0xc0) != 0xc0) {
+			*out++ = byte;
+		} else {
+			*out++ = 0xc0 | n;
+			*out++ = byte;
+		}
+		count -= n;
+	}
+
+	return out;
+}
+
+/* creates an RLE-encoded PCX file in memory */
+static unsigned char *
+make_pcx(unsigned int width, unsigned int height, unsigned int planes, size_t *sizep)
+{
+	unsigned int bytesperline = (width + 1) & ~1U;
+	unsigned char *buf, *out;
+	unsigned int x, y, p, run;
+	int16_t s;
+	uint16_t u;
+
+	/* worst case is two bytes per input byte, plus the header and palette */
+	buf = calloc(128 + (size_t)bytesperline * planes * height * 2 + 769, 1);
+	if(!buf)
+		return NULL;
+
+	buf[0] = 10;
+	buf[1] = 5;
+	buf[2] = 1;
+	buf[3] = 8;
+	s = native_to_le_short((int16_t)(width - 1));
+	memcpy(buf + 8, &s, 2);
+	s = native_to_le_short((int16_t)(height - 1));
+	memcpy(buf + 10, &s, 2);
+	buf[65] = planes;
+	u = native_to_le_ushort((uint16_t)bytesperline);
+	memcpy(buf + 66, &u, 2);
+
+	out = buf + 128;
+	for(y = 0; y < height; y++) {
+		for(p = 0; p < planes; p++) {
+			for(x = 0; x < bytesperline; x += run) {
+				unsigned char byte = x < width ? pattern(x, y, p) : 0;
+
+				for(run = 1; x + run < bytesperline; run++) {
+					if((x + run < width ? pattern(x + run, y, p) : 0) != byte)
+						break;
+				}
+				out = encode_run(out, byte, run);
+			}
+		}
+	}
+
+	if(planes == 1) {
+		*out++ = 12;
+		for(x = 0; x < 256; x++) {
+			*out++ = (unsigned char)x;
+			*out++ = (unsigned char)(255 - x);
+			*out++ = (unsigned char)(x * 3);
+		}
+	}
+
+	*sizep = out - buf;
+	return buf;
+}
+
+/* checks a decoded generated image against the pattern */
+static int
+check_pcx(const unsigned char *data, unsigned int width, unsigned int height, unsigned int planes)
+{
+	unsigned int x, y, c;
+
+	for(y = 0; y < height; y++) {
+		for(x = 0; x < width; x++, data += 3) {
+			for(c = 0; c < 3; c++) {
+				unsigned char expected;
+
+				if(planes == 1) {
+					unsigned char i = pattern(x, y, 0);
+
+					expected = c == 0 ? i : (c == 1 ? 255 - i : (unsigned char)(i * 3));
+				} else {
+					expected = pattern(x, y, c);
+				}
+				if(data[c] != expected)
+					return 0;
+			}
+		}
+	}
+
+	return 1;
+}
+
+static void
+report(const char *name, size_t in_size, unsigned int width, unsigned int height, double elapsed)
+{
+	printf("  %s: %ux%u, %.2f ms per decode, %.1f MB/s in, %.1f Mpixels/s\n", name,
+	       width, height, elapsed * 1000.0 / PCX_ROUNDS,
+	       (double)in_size * PCX_ROUNDS / elapsed / 1000000.0,
+	       (double)width * height * PCX_ROUNDS / elapsed / 1000000.0);
+}
+
+int
+bench_pcx(int num_files, char *files[])
+{
+	static const unsigned int sizes[][2] = { { 1024, 1024 }, { 4096, 4096 } };
+	unsigned char *buf, *data;
+	unsigned int width, height, planes, i, r;
+	size_t size;
+	double start;
+	char name[64];
+
+	printf("pcx decoding, %d rounds:\n", PCX_ROUNDS);
+
+	for(i = 0; i < (unsigned int)num_files; i++) {
+		FILE *fp = fopen(files[i], "rb");
+
+		if(!fp || fseek(fp, 0, SEEK_END) != 0) {
+			fprintf(stderr, "Error: Couldn't open %s\n", files[i]);
+			if(fp)
+				fclose(fp);
+			return 1;
+		}
+		size = ftell(fp);
+		fclose(fp);
+
+		start = prof_time();
+		for(r = 0; r < PCX_ROUNDS; r++) {
+			if(!(data = read_pcx(files[i], &width, &height)))
+				return 1;
+			free(data);
+		}
+		report(files[i], size, width, height, prof_time() - start);
+	}
+	if(num_files > 0)
+		return 0;
+
+	for(i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		for(planes = 1; planes <= 3; planes += 2) {
+			buf = make_pcx(sizes[i][0], sizes[i][1], planes, &size);
+			if(!buf) {
+				fprintf(stderr, "Error: Couldn't allocate memory for benchmark\n");
+				return 1;
+			}
+
+			start = prof_time();
+			for(r = 0; r < PCX_ROUNDS; r++) {
+				data = read_pcx_mem(buf, size, &width, &height);
+				if(!data || (r == 0 && !check_pcx(data, width, height, planes))) {
+					fprintf(stderr, "Error: Generated %u-bit image didn't decode correctly\n", planes * 8);
+					return 1;
+				}
+				free(data);
+			}
+
+			sprintf(name, "generated %u-bit", planes * 8);
+			report(name, size, sizes[i][0], sizes[i][1], prof_time() - start);
+			free(buf);
+		}
+	}
+
+	return 0;
+}
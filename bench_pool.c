@@ -0,0 +1,392 @@
+/*
+ * Copyright (C) 2003 Josh A. Beam
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Surface layout benchmark. Runs the per-frame passes over every surface
+ * on the same surfaces laid out three ways: as a struct holding all of
+ * its fields, each malloc'd on its own and visited in no particular
+ * order, as after a scene has been edited for a while; as an array of
+ * those structs; and in a surface pool, where each field has an array
+ * of its own. Every layout runs the same tests, so the difference is
+ * only in how the memory is reached. The passes are a frustum cull and
+ * finding the surfaces a light's sphere reaches. Also times adding
+ * surfaces to a pool in bulk and removing them one at a time.
+ *
+ * Removal does the same work whatever the pool's size, but removing
+ * surfaces scattered through a big pool misses the cache on both the
+ * removed surface's row and the last one that moves into it, so it gets
+ * slower as the pool outgrows the cache. It's also timed on a fixed
+ * number of surfaces just added at the end, which stay in the cache.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "lightmap.h"
+#include "surfpool.h"
+#include "frustum.h"
+#include "prof.h"
+
+#define LAYOUT_ROUNDS		10
+#define LAYOUT_LIGHTS		16
+#define LAYOUT_LIGHT_RADIUS	4.0f
+#define LOCAL_REMOVALS		1024U	/* surfaces added and removed at the end */
+
+/* a surface with all of its fields in one struct */
+struct whole_surface {
+	struct surface surf;
+	float vertices[4][3];
+	float matrix[9];
+	float extents[2];
+	float bounds[4];
+	struct surface_lightmap lightmap;
+	unsigned char flags;
+};
+
+extern unsigned long bench_rand();
+extern float bench_frand(float min, float max);
+extern void bench_random_corners(float v[4][3], float world, float max_side);
+
+static void
+whole_surface_init(struct whole_surface *w, float corners[4][3])
+{
+	w->surf.vertices = w->vertices;
+	w->surf.matrix = w->matrix;
+	w->surf.extents = w->extents;
+	w->surf.bounds = w->bounds;
+	w->surf.lightmap = &w->lightmap;
+	surface_init(&w->surf, corners);
+	w->flags = 0;
+}
+
+/* a 90 degree view from the middle of the world, looking down -z */
+static void
+layout_frustum(struct frustum *f, float world)
+{
+	float projection[16], modelview[16], n = 0.1f, far = world;
+
+	memset(projection, 0, sizeof(projection));
+	projection[0] = projection[5] = 1.0f;
+	projection[10] = -(far + n) / (far - n);
+	projection[11] = -1.0f;
+	projection[14] = -2.0f * far * n / (far - n);
+	memset(modelview, 0, sizeof(modelview));
+	modelview[0] = modelview[5] = modelview[10] = modelview[15] = 1.0f;
+	frustum_from_matrices(f, projection, modelview);
+}
+
+/* whether p is within radius of the rectangle with the given corner, axes and sides */
+static int
+layout_reaches(const float p[3], float radius, const float corner[3],
+               const float basis[9], const float extents[2])
+{
+	float d[3], s, t, n;
+
+	d[0] = p[0] - corner[0];
+	d[1] = p[1] - corner[1];
+	d[2] = p[2] - corner[2];
+	n = basis[6] * d[0] + basis[7] * d[1] + basis[8] * d[2];
+	if(n > radius || n < -radius)
+		return 0;
+	s = basis[0] * d[0] + basis[1] * d[1] + basis[2] * d[2];
+	t = basis[3] * d[0] + basis[4] * d[1] + basis[5] * d[2];
+
+	return s > -radius && s < extents[0] + radius && t > -radius && t < extents[1] + radius;
+}
+
+/* both passes over surfaces reached through an array of pointers */
+static unsigned int
+cull_pointers(const struct frustum *f, struct whole_surface **surfaces, unsigned int num_surfaces)
+{
+	unsigned int i, n = 0;
+
+	for(i = 0; i < num_surfaces; i++) {
+		surfaces[i]->flags = (unsigned char)frustum_cull_quad(f, surfaces[i]->vertices);
+		n += surfaces[i]->flags;
+	}
+
+	return n;
+}
+
+static unsigned int
+reach_pointers(float lights[][3], struct whole_surface **surfaces, unsigned int num_surfaces)
+{
+	const struct whole_surface *w;
+	unsigned int i, n = 0;
+	int l;
+
+	for(l = 0; l < LAYOUT_LIGHTS; l++) {
+		for(i = 0; i < num_surfaces; i++) {
+			w = surfaces[i];
+			n += layout_reaches(lights[l], LAYOUT_LIGHT_RADIUS, w->vertices[0], w->matrix, w->extents);
+		}
+	}
+
+	return n;
+}
+
+/* the same over one array of surfaces */
+static unsigned int
+cull_array(const struct frustum *f, struct whole_surface *surfaces, unsigned int num_surfaces)
+{
+	unsigned int i, n = 0;
+
+	for(i = 0; i < num_surfaces; i++) {
+		surfaces[i].flags = (unsigned char)frustum_cull_quad(f, surfaces[i].vertices);
+		n += surfaces[i].flags;
+	}
+
+	return n;
+}
+
+static unsigned int
+reach_array(float lights[][3], const struct whole_surface *surfaces, unsigned int num_surfaces)
+{
+	unsigned int i, n = 0;
+	int l;
+
+	for(l = 0; l < LAYOUT_LIGHTS; l++) {
+		for(i = 0; i < num_surfaces; i++) {
+			n += layout_reaches(lights[l], LAYOUT_LIGHT_RADIUS, surfaces[i].vertices[0],
+			                    surfaces[i].matrix, surfaces[i].extents);
+		}
+	}
+
+	return n;
+}
+
+/* and over a pool's arrays */
+static unsigned int
+cull_pool(const struct frustum *f, struct surface_pool *pool)
+{
+	unsigned int i, n = 0;
+
+	for(i = 0; i < pool->count; i++) {
+		pool->flags[i] = (unsigned char)frustum_cull_quad(f, pool->positions[i]);
+		n += pool->flags[i];
+	}
+
+	return n;
+}
+
+static unsigned int
+reach_pool(float lights[][3], const struct surface_pool *pool)
+{
+	unsigned int i, n = 0;
+	int l;
+
+	for(l = 0; l < LAYOUT_LIGHTS; l++) {
+		for(i = 0; i < pool->count; i++) {
+			n += layout_reaches(lights[l], LAYOUT_LIGHT_RADIUS, pool->positions[i][0],
+			                    pool->bases[i], pool->extents[i]);
+		}
+	}
+
+	return n;
+}
+
+static int
+bench_pool_size(unsigned int num_surfaces)
+{
+	struct surface_pool pool;
+	struct whole_surface **scattered, *array, *tmp;
+	surface_handle *handles, h, recent[LOCAL_REMOVALS];
+	float (*corners)[4][3];
+	void **filler;
+	unsigned int i, j, r, counts[3][2];
+	double start, times[3][2], add, remove, remove_recent;
+	float world, lights[LAYOUT_LIGHTS][3];
+	struct frustum frustum;
+	int ok = 1, first;
+
+	world = 20.0f * (float)pow((double)num_surfaces / 4096.0, 1.0 / 3.0);
+	layout_frustum(&frustum, world);
+
+	corners = malloc(sizeof(float) * 12 * num_surfaces);
+	array = malloc(sizeof(struct whole_surface) * num_surfaces);
+	scattered = malloc(sizeof(struct whole_surface *) * num_surfaces);
+	filler = malloc(sizeof(void *) * num_surfaces);
+	handles = malloc(sizeof(surface_handle) * num_surfaces);
+	if(!corners || !array || !scattered || !filler || !handles ||
+	   !surfpool_init(&pool, num_surfaces + LOCAL_REMOVALS)) {
+		fprintf(stderr, "Error: Couldn't allocate memory for benchmark\n");
+		return 0;
+	}
+	for(i = 0; i < num_surfaces; i++) {
+		bench_random_corners(corners[i], world, 4.0f);
+		whole_surface_init(&array[i], corners[i]);
+	}
+
+	/* bulk creation: the surfaces are built straight into the pool's arrays */
+	start = prof_time();
+	first = surfpool_alloc(&pool, num_surfaces, handles);
+	for(i = 0; i < num_surfaces; i++)
+		surface_init(&pool.records[first + i], corners[i]);
+	add = prof_time() - start;
+
+	/* scatter the separately allocated copies among other allocations, then shuffle them */
+	for(i = 0; i < num_surfaces; i++) {
+		filler[i] = malloc(16 + bench_rand() % 1024);
+		if(!(scattered[i] = malloc(sizeof(struct whole_surface)))) {
+			fprintf(stderr, "Error: Couldn't allocate memory for benchmark\n");
+			return 0;
+		}
+		whole_surface_init(scattered[i], corners[i]);
+	}
+	for(i = 0; i < num_surfaces; i++)
+		free(filler[i]);
+	for(i = num_surfaces; i > 1; i--) {
+		j = (unsigned int)((bench_rand() << 15 | bench_rand()) % i);
+		tmp = scattered[i - 1];
+		scattered[i - 1] = scattered[j];
+		scattered[j] = tmp;
+	}
+	for(i = 0; i < LAYOUT_LIGHTS; i++) {
+		lights[i][0] = bench_frand(-world * 0.5f, world * 0.5f);
+		lights[i][1] = bench_frand(-world * 0.5f, world * 0.5f);
+		lights[i][2] = bench_frand(-world * 0.5f, world * 0.5f);
+	}
+
+	memset(times, 0, sizeof(times));
+	for(r = 0; r < LAYOUT_ROUNDS; r++) {
+		start = prof_time();
+		counts[0][0] = cull_pointers(&frustum, scattered, num_surfaces);
+		times[0][0] += prof_time() - start;
+		start = prof_time();
+		counts[0][1] = reach_pointers(lights, scattered, num_surfaces);
+		times[0][1] += prof_time() - start;
+
+		start = prof_time();
+		counts[1][0] = cull_array(&frustum, array, num_surfaces);
+		times[1][0] += prof_time() - start;
+		start = prof_time();
+		counts[1][1] = reach_array(lights, array, num_surfaces);
+		times[1][1] += prof_time() - start;
+
+		start = prof_time();
+		counts[2][0] = cull_pool(&frustum, &pool);
+		times[2][0] += prof_time() - start;
+		start = prof_time();
+		counts[2][1] = reach_pool(lights, &pool);
+		times[2][1] += prof_time() - start;
+	}
+
+	/* the array and the pool hold the surfaces in the same order */
+	for(i = 0; i < num_surfaces; i++) {
+		if(pool.flags[i] != array[i].flags)
+			ok = 0;
+	}
+	for(i = 1; i < 3; i++) {
+		if(counts[i][0] != counts[0][0] || counts[i][1] != counts[0][1])
+			ok = 0;
+	}
+
+	/* remove every other surface, in a shuffled order, then check the rest are still found */
+	for(i = num_surfaces / 2; i > 1; i--) {
+		j = (unsigned int)((bench_rand() << 15 | bench_rand()) % i);
+		h = handles[(i - 1) * 2];
+		handles[(i - 1) * 2] = handles[j * 2];
+		handles[j * 2] = h;
+	}
+	start = prof_time();
+	for(i = 0; i < num_surfaces; i += 2)
+		surfpool_remove(&pool, handles[i]);
+	remove = prof_time() - start;
+	for(i = 0; i < num_surfaces; i++) {
+		first = surfpool_index(&pool, handles[i]);
+		if((i % 2 == 0) != (first < 0))
+			ok = 0;
+		else if(first >= 0 && (pool.records[first].vertices != pool.positions[first] ||
+		                       pool.positions[first][0][0] != corners[i][0][0]))
+			ok = 0;
+	}
+	if(pool.count != num_surfaces / 2)
+		ok = 0;
+
+	/* add a batch at the end and remove it again, shuffled */
+	first = surfpool_alloc(&pool, LOCAL_REMOVALS, recent);
+	for(i = 0; i < LOCAL_REMOVALS; i++)
+		surface_init(&pool.records[first + i], corners[i % num_surfaces]);
+	for(i = LOCAL_REMOVALS; i > 1; i--) {
+		j = (unsigned int)(bench_rand() % i);
+		h = recent[i - 1];
+		recent[i - 1] = recent[j];
+		recent[j] = h;
+	}
+	start = prof_time();
+	for(i = 0; i < LOCAL_REMOVALS; i++)
+		surfpool_remove(&pool, recent[i]);
+	remove_recent = prof_time() - start;
+	if(first < 0 || pool.count != num_surfaces / 2)
+		ok = 0;
+
+	printf("%7u surfaces, %u bytes each, %.1f%% culled, %.1f surfaces per light\n",
+	       num_surfaces, (unsigned int)sizeof(struct whole_surface),
+	       100.0 * counts[0][0] / num_surfaces, (double)counts[0][1] / LAYOUT_LIGHTS);
+	printf("  ns per surface       malloc'd     array      pool\n");
+	printf("  frustum cull        %9.2f %9.2f %9.2f\n",
+	       times[0][0] * 1e9 / ((double)LAYOUT_ROUNDS * num_surfaces),
+	       times[1][0] * 1e9 / ((double)LAYOUT_ROUNDS * num_surfaces),
+	       times[2][0] * 1e9 / ((double)LAYOUT_ROUNDS * num_surfaces));
+	printf("  light reach         %9.2f %9.2f %9.2f\n",
+	       times[0][1] * 1e9 / ((double)LAYOUT_ROUNDS * LAYOUT_LIGHTS * num_surfaces),
+	       times[1][1] * 1e9 / ((double)LAYOUT_ROUNDS * LAYOUT_LIGHTS * num_surfaces),
+	       times[2][1] * 1e9 / ((double)LAYOUT_ROUNDS * LAYOUT_LIGHTS * num_surfaces));
+	printf("  pool: added in %.2f ms; ns per removal: %.1f for the last %u added,\n"
+	       "        %.1f scattered (the difference is cache misses, not more work)\n",
+	       add * 1000.0, remove_recent * 1e9 / LOCAL_REMOVALS, LOCAL_REMOVALS,
+	       remove * 1e9 / ((num_surfaces + 1) / 2));
+	if(!ok)
+		printf("  MISMATCH between layouts or after removal\n");
+
+	for(i = 0; i < num_surfaces; i++)
+		free(scattered[i]);
+	surfpool_free(&pool);
+	free(handles);
+	free(filler);
+	free(scattered);
+	free(array);
+	free(corners);
+
+	return ok;
+}
+
+int
+bench_pool(int num_sizes, char *sizes[])
+{
+	static const unsigned int default_sizes[] = { 1000, 10000, 100000 };
+	int i, ok = 1;
+
+	if(num_sizes == 0) {
+		for(i = 0; i < (int)(sizeof(default_sizes) / sizeof(default_sizes[0])); i++)
+			ok &= bench_pool_size(default_sizes[i]);
+	} else {
+		for(i = 0; i < num_sizes; i++)
+			ok &= bench_pool_size((unsigned int)atoi(sizes[i]));
+	}
+
+	return ok ? 0 : 1;
+}
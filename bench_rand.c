@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) 2003 Josh A. Beam
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Random numbers and surfaces shared by the benchmarks. The generator is
+ * a fixed linear congruential one, so every run builds the same scene.
+ */
+
+#include <math.h>
+#include "lightmap.h"
+
+static unsigned long rand_state = 1;
+
+/* returns 15 random bits */
+unsigned long
+bench_rand()
+{
+	rand_state = rand_state * 1103515245UL + 12345UL;
+	return (rand_state >> 16) & 0x7fff;
+}
+
+float
+bench_frand(float min, float max)
+{
+	return min + (max - min) * (float)bench_rand() / 32767.0f;
+}
+
+/*
+ * Fills in the corners of an axis-aligned rectangle 0.5 to max_side
+ * units on a side, with its first corner inside a world box centered
+ * on the origin.
+ */
+void
+bench_random_corners(float v[4][3], float world, float max_side)
+{
+	float s_len, t_len;
+	int a = (int)bench_frand(0.0f, 2.99f), b = (a + 1) % 3, i;
+
+	s_len = bench_frand(0.5f, max_side);
+	t_len = bench_frand(0.5f, max_side);
+	for(i = 0; i < 3; i++)
+		v[0][i] = v[1][i] = v[2][i] = v[3][i] = bench_frand(-world * 0.5f, world * 0.5f);
+	v[1][b] += t_len;
+	v[2][b] += t_len;
+	v[2][a] += s_len;
+	v[3][a] += s_len;
+}
+
+/* the same for a surface whose pointers lead somewhere; see surfpool_alloc() */
+void
+bench_random_surface(struct surface *surf, float world, float max_side)
+{
+	float v[4][3];
+
+	bench_random_corners(v, world, max_side);
+	surface_init(surf, v);
+}
+
+/* stores a random direction of length len in v */
+static void
+random_direction(float v[3], float len)
+{
+	float d;
+	int i;
+
+	do {
+		for(i = 0; i < 3; i++)
+			v[i] = bench_frand(-1.0f, 1.0f);
+		d = v[0] * v[0] + v[1] * v[1] + v[2] * v[2];
+	} while(d < 0.01f || d > 1.0f);
+
+	d = len / (float)sqrt(d);
+	for(i = 0; i < 3; i++)
+		v[i] *= d;
+}
+
+/*
+ * Fills in the corners of a parallelogram 0.5 to max_side units on a
+ * side, turned to a random direction, with its first corner at origin.
+ * Its sides are at right angles unless skewed is set, in which case
+ * they're 30 to 80 degrees apart.
+ */
+void
+bench_random_quad(float v[4][3], const float origin[3], float max_side, int skewed)
+{
+	float s[3], t[3], d, angle, len;
+	int i;
+
+	random_direction(s, 1.0f);
+	do {
+		/* the part of a random direction at right angles to s */
+		random_direction(t, 1.0f);
+		d = s[0] * t[0] + s[1] * t[1] + s[2] * t[2];
+		for(i = 0; i < 3; i++)
+			t[i] -= s[i] * d;
+		len = (float)sqrt(t[0] * t[0] + t[1] * t[1] + t[2] * t[2]);
+	} while(len < 0.1f);
+	for(i = 0; i < 3; i++)
+		t[i] /= len;
+
+	if(skewed) {
+		angle = bench_frand(30.0f, 80.0f) * 3.14159265f / 180.0f;
+		for(i = 0; i < 3; i++)
+			t[i] = t[i] * (float)sin(angle) + s[i] * (float)cos(angle);
+	}
+
+	len = bench_frand(0.5f, max_side);
+	d = bench_frand(0.5f, max_side);
+	for(i = 0; i < 3; i++) {
+		v[0][i] = origin[i];
+		v[1][i] = origin[i] + t[i] * d;
+		v[3][i] = origin[i] + s[i] * len;
+		v[2][i] = v[1][i] + s[i] * len;
+	}
+}
@@ -0,0 +1,188 @@
+/*
+ * Copyright (C) 2003 Josh A. Beam
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include "bvh.h"
+
+/* used by compare_centers() */
+static int sort_axis;
+
+static float
+center(const struct surface *surf, int axis)
+{
+	/* opposite corners of the quad */
+	return (surf->vertices[0][axis] + surf->vertices[2][axis]) * 0.5f;
+}
+
+static int
+compare_centers(const void *a, const void *b)
+{
+	float c1 = center(*(const struct surface * const *)a, sort_axis);
+	float c2 = center(*(const struct surface * const *)b, sort_axis);
+
+	return c1 < c2 ? -1 : (c1 > c2 ? 1 : 0);
+}
+
+static void
+surface_bounds(const struct surface *surf, float min[3], float max[3])
+{
+	int i, j;
+
+	for(i = 0; i < 3; i++) {
+		min[i] = max[i] = surf->vertices[0][i];
+		for(j = 1; j < 4; j++) {
+			if(surf->vertices[j][i] < min[i])
+				min[i] = surf->vertices[j][i];
+			if(surf->vertices[j][i] > max[i])
+				max[i] = surf->vertices[j][i];
+		}
+	}
+}
+
+/* builds the node for items first to first + count and everything below it */
+static void
+build_node(struct bvh *bvh, unsigned int first, unsigned int count, int depth)
+{
+	struct bvh_node *node = &bvh->nodes[bvh->num_nodes++];
+	float min[3], max[3], extent, best;
+	unsigned int i, half;
+	int j;
+
+	surface_bounds(bvh->items[first], node->min, node->max);
+	for(i = first + 1; i < first + count; i++) {
+		surface_bounds(bvh->items[i], min, max);
+		for(j = 0; j < 3; j++) {
+			if(min[j] < node->min[j])
+				node->min[j] = min[j];
+			if(max[j] > node->max[j])
+				node->max[j] = max[j];
+		}
+	}
+
+	if(count <= BVH_LEAF_SIZE || depth >= BVH_MAX_DEPTH) {
+		node->first = first;
+		node->count = count;
+		node->second = 0;
+		return;
+	}
+
+	best = -1.0f;
+	for(j = 0; j < 3; j++) {
+		extent = node->max[j] - node->min[j];
+		if(extent > best) {
+			best = extent;
+			sort_axis = j;
+		}
+	}
+	qsort(bvh->items + first, count, sizeof(const struct surface *), compare_centers);
+
+	half = count / 2;
+	node->first = first;
+	node->count = 0;
+	build_node(bvh, first, half, depth + 1);
+	node->second = bvh->num_nodes;
+	build_node(bvh, first + half, count - half, depth + 1);
+}
+
+int
+bvh_build(struct bvh *bvh, struct surface **surfaces, unsigned int num_surfaces)
+{
+	unsigned int i;
+
+	bvh->num_nodes = 0;
+	bvh->num_items = num_surfaces;
+
+	/* a binary tree with at least one surface per leaf has fewer than twice as many nodes */
+	bvh->nodes = malloc(sizeof(struct bvh_node) * (num_surfaces ? num_surfaces * 2 : 1));
+	bvh->items = malloc(sizeof(const struct surface *) * (num_surfaces ? num_surfaces : 1));
+	if(!bvh->nodes || !bvh->items) {
+		bvh_free(bvh);
+		return 0;
+	}
+
+	for(i = 0; i < num_surfaces; i++)
+		bvh->items[i] = surfaces[i];
+	if(num_surfaces)
+		build_node(bvh, 0, num_surfaces, 0);
+
+	return 1;
+}
+
+void
+bvh_free(struct bvh *bvh)
+{
+	free(bvh->nodes);
+	free(bvh->items);
+	bvh->nodes = NULL;
+	bvh->items = NULL;
+	bvh->num_nodes = bvh->num_items = 0;
+}
+
+static int
+overlaps(const struct bvh_node *node, const float min[3], const float max[3])
+{
+	return (node->min[0] <= max[0] && node->max[0] >= min[0] &&
+	        node->min[1] <= max[1] && node->max[1] >= min[1] &&
+	        node->min[2] <= max[2] && node->max[2] >= min[2]);
+}
+
+unsigned int
+bvh_query_box(const struct bvh *bvh, const float min[3], const float max[3],
+              const struct surface **out, unsigned int max_out)
+{
+	unsigned int stack[BVH_MAX_DEPTH + 1];
+	unsigned int sp = 0, n = 0, i;
+	const struct bvh_node *node;
+	float smin[3], smax[3];
+
+	if(bvh->num_nodes == 0)
+		return 0;
+
+	stack[sp++] = 0;
+	while(sp > 0) {
+		node = &bvh->nodes[stack[--sp]];
+		if(!overlaps(node, min, max))
+			continue;
+
+		if(node->count == 0) {
+			stack[sp++] = node->second;
+			stack[sp++] = (unsigned int)(node - bvh->nodes) + 1;
+			continue;
+		}
+
+		for(i = node->first; i < node->first + node->count; i++) {
+			surface_bounds(bvh->items[i], smin, smax);
+			if(smin[0] > max[0] || smax[0] < min[0] ||
+			   smin[1] > max[1] || smax[1] < min[1] ||
+			   smin[2] > max[2] || smax[2] < min[2])
+				continue;
+			if(n < max_out)
+				out[n] = bvh->items[i];
+			n++;
+		}
+	}
+
+	return n;
+}
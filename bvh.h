@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2003 Josh A. Beam
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __BVH_H__
+#define __BVH_H__
+
+#include "lightmap.h"
+
+/*
+ * Bounding volume hierarchy over surfaces, split at the median of the
+ * surface centers along the longest axis until BVH_LEAF_SIZE or fewer
+ * are left. The nodes are stored depth first, so the first child of an
+ * inner node is always the one right after it.
+ */
+
+#define BVH_LEAF_SIZE	4
+
+/* nodes this deep are always leaves, so a walk needs a stack of BVH_MAX_DEPTH + 1 */
+#define BVH_MAX_DEPTH	64
+
+struct bvh_node {
+	float min[3], max[3];
+	unsigned int first, count;	/* leaf: range in bvh.items; count is 0 for inner nodes */
+	unsigned int second;		/* inner: index of the second child */
+};
+
+struct bvh {
+	struct bvh_node *nodes;
+	unsigned int num_nodes;
+	const struct surface **items;
+	unsigned int num_items;
+};
+
+/* returns 0 if there isn't enough memory */
+int bvh_build(struct bvh *bvh, struct surface **surfaces, unsigned int num_surfaces);
+void bvh_free(struct bvh *bvh);
+
+/*
+ * Stores up to max_out surfaces whose bounding boxes overlap the box
+ * from min to max in out, and returns how many were found, which may
+ * be more than max_out.
+ */
+unsigned int bvh_query_box(const struct bvh *bvh, const float min[3], const float max[3],
+                           const struct surface **out, unsigned int max_out);
+
+#endif /* __BVH_H__ */
@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2003 Josh A. Beam
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string.h>
+#include <math.h>
+#include "frustum.h"
+
+void
+matrix_multiply(const float a[16], const float b[16], float out[16])
+{
+	float tmp[16];
+	int row, col, k;
+
+	for(col = 0; col < 4; col++) {
+		for(row = 0; row < 4; row++) {
+			tmp[col * 4 + row] = 0.0f;
+			for(k = 0; k < 4; k++)
+				tmp[col * 4 + row] += a[k * 4 + row] * b[col * 4 + k];
+		}
+	}
+
+	memcpy(out, tmp, sizeof(tmp));
+}
+
+void
+matrix_rotate(float m[16], float degrees, int axis)
+{
+	float r[16];
+	float a = degrees * (float)M_PI / 180.0f;
+	int i = (axis + 1) % 3, j = (axis + 2) % 3;
+
+	memset(r, 0, sizeof(r));
+	r[0] = r[5] = r[10] = r[15] = 1.0f;
+	r[i * 4 + i] = cos(a);
+	r[j * 4 + i] = -sin(a);
+	r[i * 4 + j] = sin(a);
+	r[j * 4 + j] = cos(a);
+
+	matrix_multiply(m, r, m);
+}
+
+void
+frustum_from_matrices(struct frustum *f, const float projection[16],
+                      const float modelview[16])
+{
+	float m[16], len;
+	int p, k, row;
+
+	/* each plane is the last row of the combined matrix plus or minus one of the others */
+	matrix_multiply(projection, modelview, m);
+	for(p = 0; p < 6; p++) {
+		row = p / 2;
+		for(k = 0; k < 4; k++) {
+			if(p % 2 == 0)
+				f->planes[p][k] = m[k * 4 + 3] + m[k * 4 + row];
+			else
+				f->planes[p][k] = m[k * 4 + 3] - m[k * 4 + row];
+		}
+
+		len = sqrt(f->planes[p][0] * f->planes[p][0] +
+		           f->planes[p][1] * f->planes[p][1] +
+		           f->planes[p][2] * f->planes[p][2]);
+		if(len > 0.0f) {
+			for(k = 0; k < 4; k++)
+				f->planes[p][k] /= len;
+		}
+	}
+}
+
+int
+frustum_cull_quad(const struct frustum *f, float corners[4][3])
+{
+	const float *v;
+	int p, i;
+
+	/* the quad is convex, so it's outside if all of its corners are outside one plane */
+	for(p = 0; p < 6; p++) {
+		for(i = 0; i < 4; i++) {
+			v = corners[i];
+			if(f->planes[p][0] * v[0] + f->planes[p][1] * v[1] +
+			   f->planes[p][2] * v[2] + f->planes[p][3] >= 0.0f)
+				break;
+		}
+		if(i == 4)
+			return 1;
+	}
+
+	return 0;
+}
+
+int
+frustum_test_sphere(const struct frustum *f, const float sphere[4])
+{
+	float d;
+	int p, result = FRUSTUM_INSIDE;
+
+	for(p = 0; p < 6; p++) {
+		d = f->planes[p][0] * sphere[0] + f->planes[p][1] * sphere[1] +
+		    f->planes[p][2] * sphere[2] + f->planes[p][3];
+		if(d < -sphere[3])
+			return FRUSTUM_OUTSIDE;
+		if(d < sphere[3])
+			result = FRUSTUM_INTERSECTS;
+	}
+
+	return result;
+}
@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2003 Josh A. Beam
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __FRUSTUM_H__
+#define __FRUSTUM_H__
+
+#include "lightmap.h"
+
+/*
+ * View frustum planes in world space, pointing inwards, in the order
+ * left, right, bottom, top, near, far. Matrices are column-major, as
+ * returned by glGetFloatv().
+ */
+
+struct frustum {
+	float planes[6][4];
+};
+
+/* out = a * b */
+void matrix_multiply(const float a[16], const float b[16], float out[16]);
+
+/* multiplies m by a rotation like glRotatef() about the x, y or z axis */
+void matrix_rotate(float m[16], float degrees, int axis);
+
+void frustum_from_matrices(struct frustum *f, const float projection[16],
+                           const float modelview[16]);
+
+/* returns 1 if no part of the quad with these corners can be inside the frustum */
+int frustum_cull_quad(const struct frustum *f, float corners[4][3]);
+
+#define FRUSTUM_OUTSIDE		0
+#define FRUSTUM_INSIDE		1
+#define FRUSTUM_INTERSECTS	2
+
+/* where a sphere, given as center and radius, is relative to the frustum */
+int frustum_test_sphere(const struct frustum *f, const float sphere[4]);
+
+#endif /* __FRUSTUM_H__ */
@@ -0,0 +1,298 @@
+/*
+ * Copyright (C) 2003 Josh A. Beam
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define GL_GLEXT_PROTOTYPES
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <GL/gl.h>
+#include <GL/glext.h>
+#include "geometry.h"
+#include "atlas.h"
+#include "surfpool.h"
+
+struct batch {
+	unsigned int texture;		/* GL texture name */
+	int lightmap_page;
+	unsigned int first, count;	/* range of vertices */
+};
+
+static struct vertex *vertices = NULL;
+static unsigned int num_vertices = 0;
+static struct batch *batches = NULL;
+static unsigned int num_batches = 0;
+static unsigned int *surface_first = NULL;	/* first vertex of each surface */
+static unsigned int *sorted = NULL;		/* surface drawn from each group of 4 vertices */
+static const unsigned char *surface_flags = NULL;
+
+static unsigned int vbo = 0;
+static int mode = GEOMETRY_VBO;
+
+/* used by sort_surfaces() */
+static struct surface **sort_list;
+static const unsigned int *sort_textures;
+
+static int
+compare_surfaces(const void *a, const void *b)
+{
+	const struct surface *s1 = sort_list[*(const unsigned int *)a];
+	const struct surface *s2 = sort_list[*(const unsigned int *)b];
+	unsigned int t1 = sort_textures[s1->texture];
+	unsigned int t2 = sort_textures[s2->texture];
+
+	if(t1 != t2)
+		return t1 < t2 ? -1 : 1;
+	if(s1->lightmap->page != s2->lightmap->page)
+		return s1->lightmap->page < s2->lightmap->page ? -1 : 1;
+
+	/* keep the original order otherwise */
+	return *(const unsigned int *)a < *(const unsigned int *)b ? -1 : 1;
+}
+
+int
+have_extension(const char *name)
+{
+	const char *extensions = (const char *)glGetString(GL_EXTENSIONS);
+	const char *p;
+	size_t len = strlen(name);
+
+	for(p = extensions; p && (p = strstr(p, name)) != NULL; p += len) {
+		if((p == extensions || p[-1] == ' ') && (p[len] == ' ' || p[len] == '\0'))
+			return 1;
+	}
+
+	return 0;
+}
+
+int
+geometry_build(struct surface **surfaces, unsigned int num_surfaces,
+               const unsigned int *textures, const unsigned char *flags)
+{
+	static const float tex_coords[4][2] = {
+		{ 0.0f, 0.0f }, { 0.0f, 1.0f }, { 1.0f, 1.0f }, { 1.0f, 0.0f }
+	};
+	unsigned int *order;
+	unsigned int i, j;
+	struct vertex *v;
+	struct batch *b = NULL;
+
+	geometry_free();
+
+	order = malloc(sizeof(unsigned int) * num_surfaces);
+	vertices = malloc(sizeof(struct vertex) * num_surfaces * 4);
+	batches = malloc(sizeof(struct batch) * num_surfaces);
+	surface_first = malloc(sizeof(unsigned int) * num_surfaces);
+	sorted = malloc(sizeof(unsigned int) * num_surfaces);
+	if(!order || !vertices || !batches || !surface_first || !sorted) {
+		fprintf(stderr, "Error: Couldn't allocate memory for geometry\n");
+		free(order);
+		geometry_free();
+		return 0;
+	}
+
+	for(i = 0; i < num_surfaces; i++)
+		order[i] = i;
+	sort_list = surfaces;
+	sort_textures = textures;
+	qsort(order, num_surfaces, sizeof(unsigned int), compare_surfaces);
+
+	v = vertices;
+	for(i = 0; i < num_surfaces; i++) {
+		struct surface *surf = surfaces[order[i]];
+		unsigned int tex = textures[surf->texture];
+
+		if(!b || b->texture != tex || b->lightmap_page != surf->lightmap->page) {
+			b = &batches[num_batches++];
+			b->texture = tex;
+			b->lightmap_page = surf->lightmap->page;
+			b->first = num_vertices;
+			b->count = 0;
+		}
+
+		surface_first[order[i]] = num_vertices;
+		sorted[i] = order[i];
+		for(j = 0; j < 4; j++, v++) {
+			memcpy(v->pos, surf->vertices[j], sizeof(v->pos));
+			memcpy(v->tex_coords, tex_coords[j], sizeof(v->tex_coords));
+			memcpy(v->lightmap_coords, surf->lightmap_coords[j], sizeof(v->lightmap_coords));
+		}
+		num_vertices += 4;
+		b->count += 4;
+	}
+	free(order);
+	surface_flags = flags;
+
+	geometry_set_mode(mode);
+
+	return 1;
+}
+
+void
+geometry_free()
+{
+	if(vbo) {
+		glDeleteBuffersARB(1, &vbo);
+		vbo = 0;
+	}
+
+	free(vertices);
+	free(batches);
+	free(surface_first);
+	free(sorted);
+	vertices = NULL;
+	batches = NULL;
+	surface_first = NULL;
+	sorted = NULL;
+	surface_flags = NULL;
+	num_vertices = num_batches = 0;
+}
+
+void
+geometry_update_lightmap_coords(unsigned int index, const struct surface *surf)
+{
+	struct vertex *v = vertices + surface_first[index];
+	unsigned int i;
+
+	for(i = 0; i < 4; i++)
+		memcpy(v[i].lightmap_coords, surf->lightmap_coords[i], sizeof(v[i].lightmap_coords));
+
+	if(vbo) {
+		glBindBufferARB(GL_ARRAY_BUFFER_ARB, vbo);
+		glBufferSubDataARB(GL_ARRAY_BUFFER_ARB, sizeof(struct vertex) * surface_first[index],
+		                   sizeof(struct vertex) * 4, v);
+		glBindBufferARB(GL_ARRAY_BUFFER_ARB, 0);
+	}
+}
+
+int
+geometry_set_mode(int m)
+{
+	mode = m;
+
+	if(mode == GEOMETRY_VBO && !vbo && vertices) {
+		if(!have_extension("GL_ARB_vertex_buffer_object")) {
+			fprintf(stderr, "Vertex buffer objects aren't supported, using immediate mode\n");
+			mode = GEOMETRY_IMMEDIATE;
+			return mode;
+		}
+
+		glGenBuffersARB(1, &vbo);
+		glBindBufferARB(GL_ARRAY_BUFFER_ARB, vbo);
+		glBufferDataARB(GL_ARRAY_BUFFER_ARB, sizeof(struct vertex) * num_vertices,
+		                vertices, GL_STATIC_DRAW_ARB);
+		glBindBufferARB(GL_ARRAY_BUFFER_ARB, 0);
+	}
+
+	return mode;
+}
+
+int
+geometry_mode()
+{
+	return mode;
+}
+
+static void
+draw_immediate(unsigned int first, unsigned int count)
+{
+	const struct vertex *v = vertices + first;
+	unsigned int i;
+
+	glBegin(GL_QUADS);
+	for(i = 0; i < count; i++, v++) {
+		glMultiTexCoord2fvARB(GL_TEXTURE0_ARB, v->tex_coords);
+		glMultiTexCoord2fvARB(GL_TEXTURE1_ARB, v->lightmap_coords);
+		glVertex3fv(v->pos);
+	}
+	glEnd();
+}
+
+/* draws the runs of surfaces in b that haven't been culled */
+static void
+draw_batch(const struct batch *b)
+{
+	unsigned int i, end = (b->first + b->count) / 4, run = b->first / 4;
+
+	for(i = run; i <= end; i++) {
+		if(i < end && !(surface_flags && (surface_flags[sorted[i]] & SURFACE_CULLED)))
+			continue;
+
+		if(i > run) {
+			if(mode == GEOMETRY_VBO)
+				glDrawArrays(GL_QUADS, run * 4, (i - run) * 4);
+			else
+				draw_immediate(run * 4, (i - run) * 4);
+		}
+		run = i + 1;
+	}
+}
+
+void
+geometry_draw(int lighting)
+{
+	unsigned int i, bound_tex = 0;
+	int bound_page = -1;
+	const char *base = NULL;
+	const struct batch *b;
+
+	if(mode == GEOMETRY_VBO) {
+		glBindBufferARB(GL_ARRAY_BUFFER_ARB, vbo);
+		glEnableClientState(GL_VERTEX_ARRAY);
+		glVertexPointer(3, GL_FLOAT, sizeof(struct vertex), base + offsetof(struct vertex, pos));
+		glClientActiveTextureARB(GL_TEXTURE0_ARB);
+		glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+		glTexCoordPointer(2, GL_FLOAT, sizeof(struct vertex), base + offsetof(struct vertex, tex_coords));
+		glClientActiveTextureARB(GL_TEXTURE1_ARB);
+		glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+		glTexCoordPointer(2, GL_FLOAT, sizeof(struct vertex), base + offsetof(struct vertex, lightmap_coords));
+	}
+
+	for(i = 0; i < num_batches; i++) {
+		b = &batches[i];
+
+		if(b->texture != bound_tex) {
+			glActiveTextureARB(GL_TEXTURE0_ARB);
+			glBindTexture(GL_TEXTURE_2D, b->texture);
+			bound_tex = b->texture;
+		}
+		if(lighting && b->lightmap_page != bound_page && atlas_get_page(b->lightmap_page)) {
+			glActiveTextureARB(GL_TEXTURE1_ARB);
+			glBindTexture(GL_TEXTURE_2D, atlas_get_page(b->lightmap_page)->tex);
+			bound_page = b->lightmap_page;
+		}
+
+		draw_batch(b);
+	}
+
+	if(mode == GEOMETRY_VBO) {
+		glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+		glClientActiveTextureARB(GL_TEXTURE0_ARB);
+		glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+		glDisableClientState(GL_VERTEX_ARRAY);
+		glBindBufferARB(GL_ARRAY_BUFFER_ARB, 0);
+	}
+}
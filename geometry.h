@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2003 Josh A. Beam
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __GEOMETRY_H__
+#define __GEOMETRY_H__
+
+#include "lightmap.h"
+
+/*
+ * Surfaces are copied into one interleaved vertex array, sorted so that
+ * surfaces sharing a texture and lightmap page are next to each other,
+ * and drawn with one call per group. The array is kept in a vertex
+ * buffer object when the driver supports them.
+ */
+
+#define GEOMETRY_IMMEDIATE	0	/* glBegin/glEnd, always available */
+#define GEOMETRY_VBO		1
+
+struct vertex {
+	float pos[3];
+	float tex_coords[2];
+	float lightmap_coords[2];
+};
+
+/*
+ * Builds the vertex array for the given surfaces. textures maps each
+ * surface's texture index to a GL texture name. flags, if not NULL, is
+ * read when drawing to skip surfaces marked SURFACE_CULLED; see
+ * surfpool.h. Returns 0 on failure.
+ */
+int geometry_build(struct surface **surfaces, unsigned int num_surfaces,
+                   const unsigned int *textures, const unsigned char *flags);
+void geometry_free();
+
+/*
+ * Copies new lightmap coordinates for a surface into the vertex array.
+ * index is the surface's position in the array given to geometry_build().
+ */
+void geometry_update_lightmap_coords(unsigned int index, const struct surface *surf);
+
+/*
+ * Draws every surface that isn't culled; the lightmap pages are bound to
+ * TEXTURE1 if lighting is set.
+ */
+void geometry_draw(int lighting);
+
+/* returns the mode actually in use, which falls back to GEOMETRY_IMMEDIATE */
+int geometry_set_mode(int mode);
+int geometry_mode();
+
+#endif /* __GEOMETRY_H__ */
@@ -0,0 +1,271 @@
+/*
+ * Copyright (C) 2003 Josh A. Beam
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Renders the demo without a window, through a surfaceless EGL context
+ * (e.g. Mesa's software rasterizer) into a framebuffer object. The
+ * animation is advanced by a fixed step per frame instead of by the
+ * clock, so every run draws the same frames. Prints a checksum of each
+ * frame's pixels followed by the frame timings; the frame phase includes
+ * reading the pixels back.
+ */
+
+#define GL_GLEXT_PROTOTYPES
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GL/gl.h>
+#include <GL/glext.h>
+#include <GL/glu.h>
+#include "prof.h"
+#include "shadow.h"
+
+#define WIDTH		400
+#define HEIGHT		300
+#define FRAME_STEP	(1.0f / 60.0f)	/* seconds of animation per frame */
+
+extern int have_extension(const char *name);
+extern void scene_set_file(const char *filename);
+extern void scene_set_swap_func(void (*swap)());
+extern void scene_set_lightmap_budget(unsigned int usec);
+extern void scene_set_lightmap_limit(unsigned int count);
+extern unsigned int scene_longest_lightmap_wait();
+extern void scene_toggle_shader();
+extern void scene_toggle_shadows();
+extern void scene_render();
+extern void scene_finish_loading();
+extern void scene_update(float seconds);
+extern void scene_interpolate(float alpha);
+
+static int
+create_context()
+{
+	PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display;
+	EGLDisplay display;
+	EGLContext context;
+	EGLint major, minor;
+
+	get_platform_display = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	if(!get_platform_display) {
+		fprintf(stderr, "Error: eglGetPlatformDisplayEXT isn't available\n");
+		return 0;
+	}
+
+	display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+	if(display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)) {
+		fprintf(stderr, "Error: Couldn't open a surfaceless EGL display\n");
+		return 0;
+	}
+
+	eglBindAPI(EGL_OPENGL_API);
+	context = eglCreateContext(display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, NULL);
+	if(context == EGL_NO_CONTEXT ||
+	   !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+		fprintf(stderr, "Error: Couldn't create an EGL context\n");
+		return 0;
+	}
+
+	return 1;
+}
+
+/* renders into a WIDTH x HEIGHT color and depth buffer instead of a window */
+static int
+create_framebuffer()
+{
+	unsigned int fb, rb[2];
+
+	if(!have_extension("GL_EXT_framebuffer_object")) {
+		fprintf(stderr, "Error: Framebuffer objects aren't supported\n");
+		return 0;
+	}
+
+	glGenFramebuffersEXT(1, &fb);
+	glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, fb);
+	glGenRenderbuffersEXT(2, rb);
+	glBindRenderbufferEXT(GL_RENDERBUFFER_EXT, rb[0]);
+	glRenderbufferStorageEXT(GL_RENDERBUFFER_EXT, GL_RGBA8, WIDTH, HEIGHT);
+	glFramebufferRenderbufferEXT(GL_FRAMEBUFFER_EXT, GL_COLOR_ATTACHMENT0_EXT, GL_RENDERBUFFER_EXT, rb[0]);
+	glBindRenderbufferEXT(GL_RENDERBUFFER_EXT, rb[1]);
+	glRenderbufferStorageEXT(GL_RENDERBUFFER_EXT, GL_DEPTH_COMPONENT24, WIDTH, HEIGHT);
+	glFramebufferRenderbufferEXT(GL_FRAMEBUFFER_EXT, GL_DEPTH_ATTACHMENT_EXT, GL_RENDERBUFFER_EXT, rb[1]);
+
+	if(glCheckFramebufferStatusEXT(GL_FRAMEBUFFER_EXT) != GL_FRAMEBUFFER_COMPLETE_EXT) {
+		fprintf(stderr, "Error: Framebuffer is incomplete\n");
+		return 0;
+	}
+
+	glViewport(0, 0, WIDTH, HEIGHT);
+
+	return 1;
+}
+
+/* waits for the frame to be drawn, so it's counted in the frame's time */
+static void
+finish()
+{
+	glFinish();
+}
+
+/* 32 bit FNV-1a */
+static unsigned long
+checksum(const unsigned char *data, unsigned int size)
+{
+	unsigned long hash = 2166136261UL;
+	unsigned int i;
+
+	for(i = 0; i < size; i++) {
+		hash ^= data[i];
+		hash = (hash * 16777619UL) & 0xffffffffUL;
+	}
+
+	return hash;
+}
+
+static int
+write_ppm(const char *filename, const unsigned char *pixels)
+{
+	FILE *fp;
+	int y;
+
+	fp = fopen(filename, "wb");
+	if(!fp) {
+		fprintf(stderr, "Error: Couldn't open %s for writing\n", filename);
+		return 0;
+	}
+
+	/* rows are read bottom up */
+	fprintf(fp, "P6\n%d %d\n255\n", WIDTH, HEIGHT);
+	for(y = HEIGHT - 1; y >= 0; y--)
+		fwrite(pixels + y * WIDTH * 3, WIDTH * 3, 1, fp);
+	fclose(fp);
+
+	return 1;
+}
+
+static void
+usage(const char *argv0)
+{
+	fprintf(stderr, "usage: %s [-n frames] [-o last.ppm] [-csv profile.csv] [-budget us]\n"
+	                "       [-lightmaps n] [-rays n] [-max-wait n] [-shader] [-shadows]\n"
+	                "       [scene file]\n", argv0);
+	exit(1);
+}
+
+int
+main(int argc, char *argv[])
+{
+	unsigned int frames = 100, f, max_wait = 0;
+	const char *ppm_file = NULL, *csv_file = NULL;
+	int shader = 0, shadows = 0, i;
+	unsigned char *pixels;
+
+	for(i = 1; i < argc; i++) {
+		if(strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+			frames = atoi(argv[++i]);
+		else if(strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+			ppm_file = argv[++i];
+		else if(strcmp(argv[i], "-csv") == 0 && i + 1 < argc)
+			csv_file = argv[++i];
+		else if(strcmp(argv[i], "-budget") == 0 && i + 1 < argc) {
+			fprintf(stderr, "Warning: -budget depends on timing, so the checksums can differ "
+			                "between runs; -lightmaps n doesn't\n");
+			scene_set_lightmap_budget(atoi(argv[++i]));
+		} else if(strcmp(argv[i], "-lightmaps") == 0 && i + 1 < argc)
+			scene_set_lightmap_limit(atoi(argv[++i]));
+		else if(strcmp(argv[i], "-rays") == 0 && i + 1 < argc)
+			shadow_set_budget(atol(argv[++i]));
+		else if(strcmp(argv[i], "-max-wait") == 0 && i + 1 < argc)
+			max_wait = atoi(argv[++i]);
+		else if(strcmp(argv[i], "-shader") == 0)
+			shader = 1;
+		else if(strcmp(argv[i], "-shadows") == 0)
+			shadows = 1;
+		else if(argv[i][0] != '-')
+			scene_set_file(argv[i]);
+		else
+			usage(argv[0]);
+	}
+
+	pixels = malloc(WIDTH * HEIGHT * 3);
+	if(!pixels) {
+		fprintf(stderr, "Error: Couldn't allocate memory for pixels\n");
+		return 1;
+	}
+
+	if(!create_context() || !create_framebuffer())
+		return 1;
+
+	/* the same GL settings as main.c */
+	glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+	glClearDepth(1.0f);
+
+	glDisable(GL_BLEND);
+	glEnable(GL_DEPTH_TEST);
+	glColor4f(1.0f, 1.0f, 1.0f, 1.0f);
+
+	glMatrixMode(GL_PROJECTION);
+	glLoadIdentity();
+	gluPerspective(45.0f, (float)WIDTH / (float)HEIGHT, 0.1f, 200.0f);
+	glMatrixMode(GL_MODELVIEW);
+
+	scene_set_swap_func(finish);
+	if(shader)
+		scene_toggle_shader();
+	if(shadows)
+		scene_toggle_shadows();
+
+	/* textures load in the background; don't let them arrive at different frames each run */
+	scene_finish_loading();
+
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	for(f = 0; f < frames; f++) {
+		scene_update(FRAME_STEP);
+		scene_interpolate(1.0f);
+		scene_render();
+
+		glReadPixels(0, 0, WIDTH, HEIGHT, GL_RGB, GL_UNSIGNED_BYTE, pixels);
+		printf("frame %u checksum %08lx\n", f, checksum(pixels, WIDTH * HEIGHT * 3));
+	}
+
+	if(frames > 0 && ppm_file)
+		write_ppm(ppm_file, pixels);
+
+	prof_print();
+	if(csv_file)
+		prof_dump_csv(csv_file);
+
+	free(pixels);
+
+	printf("lightmaps put off for at most %u frames\n", scene_longest_lightmap_wait());
+	if(max_wait > 0 && scene_longest_lightmap_wait() > max_wait) {
+		fprintf(stderr, "Error: a lightmap was put off for more than %u frames\n", max_wait);
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,321 @@
+/*
+ * Copyright (C) 2003 Josh A. Beam
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <math.h>
+#include "light.h"
+
+static struct light lights[MAX_LIGHTS];
+static int in_use[MAX_LIGHTS];
+static int max_id = 0;
+
+/*
+ * Each light remembers the state it was in the last time it was
+ * considered changed, the state before that, and the value of
+ * change_stamp at that time.
+ */
+static struct light sig_lights[MAX_LIGHTS];
+static struct light prev_lights[MAX_LIGHTS];
+static unsigned long changed_at[MAX_LIGHTS];
+static unsigned long change_stamp = 0;
+
+static int use_reach_masks = 0;
+
+static void
+mark_changed(int id)
+{
+	prev_lights[id] = sig_lights[id];
+	sig_lights[id] = lights[id];
+	changed_at[id] = ++change_stamp;
+}
+
+static int
+differs(const float a[3], const float b[3], float tolerance)
+{
+	return (fabs(a[0] - b[0]) > tolerance ||
+	        fabs(a[1] - b[1]) > tolerance ||
+	        fabs(a[2] - b[2]) > tolerance);
+}
+
+static int
+valid_id(int id)
+{
+	return (id >= 0 && id < max_id && in_use[id]);
+}
+
+int
+light_add(const float pos[3], const float color[3], float radius,
+          unsigned int flags)
+{
+	int i, id;
+
+	for(id = 0; id < MAX_LIGHTS; id++) {
+		if(!in_use[id])
+			break;
+	}
+	if(id == MAX_LIGHTS) {
+		fprintf(stderr, "Error: Too many lights (max %d)\n", MAX_LIGHTS);
+		return -1;
+	}
+
+	for(i = 0; i < 3; i++) {
+		lights[id].pos[i] = pos[i];
+		lights[id].color[i] = color[i];
+	}
+	lights[id].radius = radius;
+	lights[id].flags = flags;
+	in_use[id] = 1;
+	mark_changed(id);
+
+	/* it was dark before */
+	prev_lights[id] = lights[id];
+	for(i = 0; i < 3; i++)
+		prev_lights[id].color[i] = 0.0f;
+
+	if(id >= max_id)
+		max_id = id + 1;
+
+	return id;
+}
+
+void
+light_remove(int id)
+{
+	if(!valid_id(id))
+		return;
+
+	in_use[id] = 0;
+	while(max_id > 0 && !in_use[max_id - 1])
+		max_id--;
+}
+
+void
+light_move(int id, const float pos[3])
+{
+	if(!valid_id(id))
+		return;
+
+	lights[id].pos[0] = pos[0];
+	lights[id].pos[1] = pos[1];
+	lights[id].pos[2] = pos[2];
+
+	if(differs(lights[id].pos, sig_lights[id].pos, LIGHT_POS_TOLERANCE))
+		mark_changed(id);
+}
+
+void
+light_set_color(int id, const float color[3])
+{
+	if(!valid_id(id))
+		return;
+
+	lights[id].color[0] = color[0];
+	lights[id].color[1] = color[1];
+	lights[id].color[2] = color[2];
+
+	if(differs(lights[id].color, sig_lights[id].color, LIGHT_COLOR_TOLERANCE))
+		mark_changed(id);
+}
+
+void
+light_set_radius(int id, float radius)
+{
+	if(!valid_id(id))
+		return;
+
+	lights[id].radius = radius;
+	mark_changed(id);
+}
+
+const struct light *
+light_get(int id)
+{
+	if(!valid_id(id))
+		return NULL;
+
+	return &lights[id];
+}
+
+int
+light_max_id()
+{
+	return max_id;
+}
+
+unsigned long
+light_changed_at(int id)
+{
+	if(!valid_id(id))
+		return 0;
+
+	return changed_at[id];
+}
+
+void
+light_set_reach_masks(int enabled)
+{
+	use_reach_masks = enabled;
+}
+
+float
+light_cull_radius(const struct light *light)
+{
+	float brightest, r;
+
+	brightest = light->color[0];
+	if(light->color[1] > brightest)
+		brightest = light->color[1];
+	if(light->color[2] > brightest)
+		brightest = light->color[2];
+	if(brightest <= 0.0f)
+		return 0.0f;
+
+	/*
+	 * A light adds 255 * color / max(1, d^2 * 0.5) to a texel, which
+	 * is less than one step once d^2 > 510 * color.
+	 */
+	r = sqrt(510.0f * brightest);
+	if(light->radius > 0.0f && light->radius < r)
+		r = light->radius;
+
+	return r;
+}
+
+/* gathers the lights reaching surf whose flags masked with flag_mask equal flag_value */
+static unsigned int
+gather(const struct surface *surf, struct light *out, unsigned int *mask,
+       unsigned int flag_mask, unsigned int flag_value)
+{
+	unsigned int n = 0;
+	int i, id;
+
+	if(mask) {
+		for(i = 0; i < LIGHT_MASK_WORDS; i++)
+			mask[i] = 0;
+	}
+
+	for(id = 0; id < max_id; id++) {
+		float r;
+
+		if(!in_use[id] || (lights[id].flags & flag_mask) != flag_value)
+			continue;
+
+		if(use_reach_masks) {
+			if(!(surf->light_reach[id / 32] & (1U << (id % 32))))
+				continue;
+		} else {
+			r = light_cull_radius(&lights[id]);
+			if(surface_distance_sq(surf, lights[id].pos) >= r * r)
+				continue;
+		}
+
+		out[n++] = lights[id];
+		if(mask)
+			mask[id / 32] |= 1U << (id % 32);
+	}
+
+	return n;
+}
+
+unsigned int
+light_gather(const struct surface *surf, struct light *out, unsigned int *mask)
+{
+	return gather(surf, out, mask, 0, 0);
+}
+
+unsigned int
+light_gather_static(const struct surface *surf, struct light *out)
+{
+	return gather(surf, out, NULL, LIGHT_STATIC, LIGHT_STATIC);
+}
+
+unsigned int
+light_gather_dynamic(const struct surface *surf, struct light *out, unsigned int *mask)
+{
+	return gather(surf, out, mask, LIGHT_STATIC, 0);
+}
+
+/* returns how much a light going from state a to state b changes a texel at surf, 0 to 255 */
+static float
+change_at(const struct surface *surf, const struct light *a, const struct light *b)
+{
+	float da, db, delta, most = 0.0f;
+	int c;
+
+	/* the same falloff as the lightmaps */
+	da = surface_distance_sq(surf, a->pos) * 0.5f;
+	db = surface_distance_sq(surf, b->pos) * 0.5f;
+	da = 1.0f / (da < 1.0f ? 1.0f : da);
+	db = 1.0f / (db < 1.0f ? 1.0f : db);
+
+	for(c = 0; c < 3; c++) {
+		delta = (float)fabs(b->color[c] * db - a->color[c] * da);
+		if(delta > most)
+			most = delta;
+	}
+
+	return most > 1.0f ? 255.0f : 255.0f * most;
+}
+
+int
+light_surface_changed(struct surface *surf, const unsigned int *mask, float *change)
+{
+	struct light dark;
+	unsigned int crossed;
+	int changed = 0;
+	int i, id;
+	float c, most = 0.0f;
+
+	dark.color[0] = dark.color[1] = dark.color[2] = 0.0f;
+	for(id = 0; id < max_id; id++) {
+		crossed = (surf->light_mask[id / 32] ^ mask[id / 32]) & (1U << (id % 32));
+		if(crossed) {
+			/* entered or left its range */
+			changed = 1;
+			dark.pos[0] = lights[id].pos[0];
+			dark.pos[1] = lights[id].pos[1];
+			dark.pos[2] = lights[id].pos[2];
+			c = change_at(surf, &dark, &lights[id]);
+		} else if((mask[id / 32] & (1U << (id % 32))) && changed_at[id] > surf->light_stamp) {
+			changed = 1;
+			c = change_at(surf, &prev_lights[id], &sig_lights[id]);
+		} else {
+			continue;
+		}
+		if(c > most)
+			most = c;
+	}
+	for(i = 0; i < LIGHT_MASK_WORDS; i++) {
+		if(surf->light_mask[i] != mask[i])
+			changed = 1;
+		surf->light_mask[i] = mask[i];
+	}
+
+	surf->light_stamp = change_stamp;
+	if(change)
+		*change = most;
+
+	return changed;
+}
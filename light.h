@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2003 Josh A. Beam
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __LIGHT_H__
+#define __LIGHT_H__
+
+#include "lightmap.h"
+
+/*
+ * Lights that move or change color by less than these amounts since the
+ * last time they were considered changed don't cause surfaces to be
+ * relit.
+ */
+#define LIGHT_POS_TOLERANCE	0.001f
+#define LIGHT_COLOR_TOLERANCE	(1.0f / 512.0f)
+
+/*
+ * Adds a light to the scene and returns its id, or -1 if there are
+ * already MAX_LIGHTS lights. A radius of 0 means the light reaches as
+ * far as its falloff stays visible. flags is a combination of the
+ * LIGHT_* flags in lightmap.h.
+ */
+int light_add(const float pos[3], const float color[3], float radius,
+              unsigned int flags);
+void light_remove(int id);
+void light_move(int id, const float pos[3]);
+void light_set_color(int id, const float color[3]);
+void light_set_radius(int id, float radius);
+const struct light *light_get(int id);
+
+/* returns the highest light id in use plus one */
+int light_max_id();
+
+/*
+ * Distance at which a light stops contributing to a lightmap: either its
+ * radius, or the distance at which its falloff drops below one
+ * quantization step, whichever is smaller.
+ */
+float light_cull_radius(const struct light *light);
+
+/* returns a number that increases each time the light is added or changed */
+unsigned long light_changed_at(int id);
+
+/*
+ * While enabled, light_gather() and friends trust each surface's
+ * light_reach mask, kept up to date by lightgrid_update(), instead of
+ * testing every light against the surface.
+ */
+void light_set_reach_masks(int enabled);
+
+/*
+ * Copies the lights that can reach surf into out, which must have room
+ * for MAX_LIGHTS lights, and returns how many there are. If mask isn't
+ * NULL, the ids of those lights are stored in it as a bitmask of
+ * LIGHT_MASK_WORDS words.
+ */
+unsigned int light_gather(const struct surface *surf, struct light *out,
+                          unsigned int *mask);
+
+/* the same, but only for lights with or without LIGHT_STATIC */
+unsigned int light_gather_static(const struct surface *surf, struct light *out);
+unsigned int light_gather_dynamic(const struct surface *surf, struct light *out,
+                                  unsigned int *mask);
+
+/*
+ * Given the mask returned by light_gather(), returns 1 if surf's lightmap
+ * needs to be recomputed because a light entered or left its range or
+ * changed beyond the tolerances above since the last call. Returns 0 if
+ * the cached lightmap is still good, as far as the lights go; see
+ * SURFACE_DIRTY in surfpool.h. Either way, the surface's cached
+ * signature is brought up to date. If change isn't NULL, it's set to the
+ * most any of those lights' last changes moved a texel value at the
+ * surface's nearest point, from 0 to 255.
+ */
+int light_surface_changed(struct surface *surf, const unsigned int *mask, float *change);
+
+#endif /* __LIGHT_H__ */
@@ -0,0 +1,313 @@
+/*
+ * Copyright (C) 2003 Josh A. Beam
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "lightgrid.h"
+#include "light.h"
+
+static struct surface **surfaces = NULL;
+static unsigned int num_surfaces = 0;
+
+static float origin[3];
+static float cell_size, inv_cell_size;
+static int dims[3];
+
+/* the surfaces overlapping cell c are cell_items[cell_start[c]] to cell_items[cell_start[c + 1]] */
+static unsigned int *cell_start = NULL;
+static unsigned int *cell_items = NULL;
+
+/* so that a surface in several cells is only returned once per query */
+static unsigned int *marks = NULL;
+static unsigned int query_mark = 0;
+
+/* the surfaces each light reached when it was last looked up */
+static unsigned int *reached[MAX_LIGHTS];
+static unsigned int num_reached[MAX_LIGHTS];
+static unsigned int max_reached[MAX_LIGHTS];
+static unsigned long looked_up_at[MAX_LIGHTS];
+
+static void
+surface_bounds(const struct surface *surf, float min[3], float max[3])
+{
+	int i, j;
+
+	for(i = 0; i < 3; i++) {
+		min[i] = max[i] = surf->vertices[0][i];
+		for(j = 1; j < 4; j++) {
+			if(surf->vertices[j][i] < min[i])
+				min[i] = surf->vertices[j][i];
+			if(surf->vertices[j][i] > max[i])
+				max[i] = surf->vertices[j][i];
+		}
+	}
+}
+
+static int
+cell_coord(float x, int axis)
+{
+	int c = (int)floor((x - origin[axis]) * inv_cell_size);
+
+	if(c < 0)
+		return 0;
+	if(c >= dims[axis])
+		return dims[axis] - 1;
+	return c;
+}
+
+/* counts item in, or if fill is set stores it in, each cell the box overlaps */
+static void
+add_to_cells(const float min[3], const float max[3], unsigned int item, int fill)
+{
+	int lo[3], hi[3], x, y, z;
+	unsigned int c;
+
+	for(x = 0; x < 3; x++) {
+		lo[x] = cell_coord(min[x], x);
+		hi[x] = cell_coord(max[x], x);
+	}
+
+	for(z = lo[2]; z <= hi[2]; z++) {
+		for(y = lo[1]; y <= hi[1]; y++) {
+			for(x = lo[0]; x <= hi[0]; x++) {
+				c = ((unsigned int)z * dims[1] + y) * dims[0] + x;
+				if(fill)
+					cell_items[--cell_start[c]] = item;
+				else
+					cell_start[c]++;
+			}
+		}
+	}
+}
+
+int
+lightgrid_build(struct surface **s, unsigned int n)
+{
+	float min[3], max[3], smin[3], smax[3], extent = 0.0f, volume;
+	unsigned int i, num_cells, total;
+	int j;
+
+	lightgrid_free();
+	if(n == 0)
+		return 1;
+
+	surface_bounds(s[0], min, max);
+	for(i = 0; i < n; i++) {
+		surface_bounds(s[i], smin, smax);
+		for(j = 0; j < 3; j++) {
+			if(smin[j] < min[j])
+				min[j] = smin[j];
+			if(smax[j] > max[j])
+				max[j] = smax[j];
+			extent += smax[j] - smin[j];
+		}
+	}
+
+	/*
+	 * Cells about as big as the average surface, but no more of them
+	 * than LIGHTGRID_CELLS_PER_SURFACE per surface.
+	 */
+	cell_size = extent / (3.0f * (float)n);
+	volume = 1.0f;
+	for(j = 0; j < 3; j++)
+		volume *= (max[j] - min[j]) + 1e-3f;
+	if(cell_size * cell_size * cell_size * LIGHTGRID_CELLS_PER_SURFACE * n < volume)
+		cell_size = pow(volume / ((float)LIGHTGRID_CELLS_PER_SURFACE * n), 1.0 / 3.0);
+	if(cell_size <= 0.0f)
+		cell_size = 1.0f;
+	inv_cell_size = 1.0f / cell_size;
+
+	num_cells = 1;
+	for(j = 0; j < 3; j++) {
+		origin[j] = min[j];
+		dims[j] = (int)((max[j] - min[j]) * inv_cell_size) + 1;
+		num_cells *= dims[j];
+	}
+
+	cell_start = calloc(num_cells + 1, sizeof(unsigned int));
+	marks = calloc(n, sizeof(unsigned int));
+	if(!cell_start || !marks) {
+		fprintf(stderr, "Error: Couldn't allocate memory for light grid\n");
+		lightgrid_free();
+		return 0;
+	}
+
+	/* count the surfaces in each cell, then turn the counts into where each cell ends */
+	for(i = 0; i < n; i++) {
+		surface_bounds(s[i], smin, smax);
+		add_to_cells(smin, smax, i, 0);
+	}
+	for(i = 1; i < num_cells; i++)
+		cell_start[i] += cell_start[i - 1];
+	total = cell_start[num_cells] = cell_start[num_cells - 1];
+
+	cell_items = malloc(sizeof(unsigned int) * (total ? total : 1));
+	if(!cell_items) {
+		fprintf(stderr, "Error: Couldn't allocate memory for light grid\n");
+		lightgrid_free();
+		return 0;
+	}
+
+	/* filling from the end of each cell leaves cell_start pointing at the beginnings */
+	for(i = 0; i < n; i++) {
+		surface_bounds(s[i], smin, smax);
+		add_to_cells(smin, smax, i, 1);
+	}
+
+	surfaces = s;
+	num_surfaces = n;
+	for(i = 0; i < n; i++)
+		memset(surfaces[i]->light_reach, 0, sizeof(surfaces[i]->light_reach));
+	light_set_reach_masks(1);
+
+	return 1;
+}
+
+void
+lightgrid_free()
+{
+	int id;
+
+	if(surfaces)
+		light_set_reach_masks(0);
+
+	free(cell_start);
+	free(cell_items);
+	free(marks);
+	cell_start = cell_items = marks = NULL;
+	surfaces = NULL;
+	num_surfaces = 0;
+
+	for(id = 0; id < MAX_LIGHTS; id++) {
+		free(reached[id]);
+		reached[id] = NULL;
+		num_reached[id] = max_reached[id] = 0;
+		looked_up_at[id] = 0;
+	}
+}
+
+unsigned int
+lightgrid_query(const float center[3], float radius, unsigned int *out,
+                unsigned int max_out)
+{
+	int lo[3], hi[3], x, y, z, j;
+	unsigned int c, i, item, n = 0;
+	float r2 = radius * radius;
+
+	if(!surfaces)
+		return 0;
+
+	if(++query_mark == 0) {
+		memset(marks, 0, sizeof(unsigned int) * num_surfaces);
+		query_mark = 1;
+	}
+
+	for(j = 0; j < 3; j++) {
+		lo[j] = cell_coord(center[j] - radius, j);
+		hi[j] = cell_coord(center[j] + radius, j);
+	}
+
+	for(z = lo[2]; z <= hi[2]; z++) {
+		for(y = lo[1]; y <= hi[1]; y++) {
+			for(x = lo[0]; x <= hi[0]; x++) {
+				c = ((unsigned int)z * dims[1] + y) * dims[0] + x;
+				for(i = cell_start[c]; i < cell_start[c + 1]; i++) {
+					item = cell_items[i];
+					if(marks[item] == query_mark)
+						continue;
+					marks[item] = query_mark;
+
+					if(surface_distance_sq(surfaces[item], center) < r2) {
+						if(n < max_out)
+							out[n] = item;
+						n++;
+					}
+				}
+			}
+		}
+	}
+
+	return n;
+}
+
+static void
+set_reach_bits(int id, int set)
+{
+	unsigned int i, word = id / 32, bit = 1U << (id % 32);
+
+	for(i = 0; i < num_reached[id]; i++) {
+		if(set)
+			surfaces[reached[id][i]]->light_reach[word] |= bit;
+		else
+			surfaces[reached[id][i]]->light_reach[word] &= ~bit;
+	}
+}
+
+void
+lightgrid_update()
+{
+	const struct light *light;
+	unsigned int n;
+	float r;
+	int id;
+
+	if(!surfaces)
+		return;
+
+	for(id = 0; id < MAX_LIGHTS; id++) {
+		light = light_get(id);
+
+		/* removed */
+		if(!light) {
+			set_reach_bits(id, 0);
+			num_reached[id] = 0;
+			looked_up_at[id] = 0;
+			continue;
+		}
+		if(light_changed_at(id) <= looked_up_at[id])
+			continue;
+
+		set_reach_bits(id, 0);
+		r = light_cull_radius(light);
+		n = lightgrid_query(light->pos, r, reached[id], max_reached[id]);
+		if(n > max_reached[id]) {
+			unsigned int *list = realloc(reached[id], sizeof(unsigned int) * n);
+
+			if(!list) {
+				fprintf(stderr, "Error: Couldn't allocate memory for light grid\n");
+				num_reached[id] = 0;
+				continue;
+			}
+			reached[id] = list;
+			max_reached[id] = n;
+			lightgrid_query(light->pos, r, reached[id], n);
+		}
+		num_reached[id] = n;
+		set_reach_bits(id, 1);
+		looked_up_at[id] = light_changed_at(id);
+	}
+}
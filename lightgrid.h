@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2003 Josh A. Beam
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __LIGHTGRID_H__
+#define __LIGHTGRID_H__
+
+#include "lightmap.h"
+
+/*
+ * Uniform grid over the bounding boxes of the scene's surfaces, used to
+ * find the surfaces within reach of each light without looking at all
+ * of them. Each light keeps the list of surfaces it reached the last
+ * time it was looked up, and lightgrid_update() only looks up the lights
+ * that were added, removed or changed since then, keeping every
+ * surface's light_reach mask up to date.
+ *
+ * The surfaces mustn't move after lightgrid_build().
+ */
+
+/* the grid never has more than this many cells per surface */
+#define LIGHTGRID_CELLS_PER_SURFACE	4
+
+/*
+ * Builds the grid and turns on light_reach masks in light.c. Returns 0
+ * if there isn't enough memory.
+ */
+int lightgrid_build(struct surface **surfaces, unsigned int num_surfaces);
+void lightgrid_free();
+
+/* brings the light_reach masks up to date with the lights that have changed */
+void lightgrid_update();
+
+/*
+ * Stores the indices of up to max_out surfaces that are closer than
+ * radius to center in out and returns how many there are, which may be
+ * more than max_out.
+ */
+unsigned int lightgrid_query(const float center[3], float radius,
+                             unsigned int *out, unsigned int max_out);
+
+#endif /* __LIGHTGRID_H__ */
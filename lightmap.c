@@ -0,0 +1,487 @@
+/*
+ * Copyright (C) 2003 Josh A. Beam
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "lightmap.h"
+
+#if defined(__SSE2__)
+extern void lightmap_compute_sse2(const struct surface *surf, const struct light *lights,
+                                  unsigned int num_lights, unsigned char *data,
+                                  unsigned int width, unsigned int height,
+                                  unsigned int pitch);
+#if defined(__GNUC__)
+#define HAVE_AVX2_KERNEL
+extern int lightmap_cpu_has_avx2();
+extern void lightmap_compute_avx2(const struct surface *surf, const struct light *lights,
+                                  unsigned int num_lights, unsigned char *data,
+                                  unsigned int width, unsigned int height,
+                                  unsigned int pitch);
+#endif
+#endif
+
+typedef void (*lightmap_kernel_func)(const struct surface *, const struct light *,
+                                     unsigned int, unsigned char *, unsigned int,
+                                     unsigned int, unsigned int);
+
+static float
+dot_product(const float v1[3], const float v2[3])
+{
+	return (v1[0] * v2[0] + v1[1] * v2[1] + v1[2] * v2[2]);
+}
+
+static void
+normalize(float v[3])
+{
+	float f = 1.0f / sqrt(dot_product(v, v));
+
+	v[0] *= f;
+	v[1] *= f;
+	v[2] *= f;
+}
+
+static void
+cross_product(const float *v1, const float *v2, float *out)
+{
+	out[0] = v1[1] * v2[2] - v1[2] * v2[1];
+	out[1] = v1[2] * v2[0] - v1[0] * v2[2];
+	out[2] = v1[0] * v2[1] - v1[1] * v2[0];
+}
+
+static void
+multiply_vector_by_matrix(const float m[9], float v[3])
+{
+	float tmp[3];
+
+	tmp[0] = v[0] * m[0] + v[1] * m[3] + v[2] * m[6];
+	tmp[1] = v[0] * m[1] + v[1] * m[4] + v[2] * m[7];
+	tmp[2] = v[0] * m[2] + v[1] * m[5] + v[2] * m[8];
+
+	v[0] = tmp[0];
+	v[1] = tmp[1];
+	v[2] = tmp[2];
+}
+
+void
+surface_init(struct surface *surf, float vertices[4][3])
+{
+	int i, j;
+
+	for(i = 0; i < 4; i++) {
+		for(j = 0; j < 3; j++)
+			surf->vertices[i][j] = vertices[i][j];
+	}
+
+	/* x axis of matrix points in world space direction of the s texture axis */
+	for(i = 0; i < 3; i++)
+		surf->matrix[0 + i] = surf->vertices[3][i] - surf->vertices[0][i];
+	surf->extents[0] = sqrt(dot_product(surf->matrix, surf->matrix));
+	normalize(surf->matrix);
+
+	/* y axis of matrix points in world space direction of the t texture axis */
+	for(i = 0; i < 3; i++)
+		surf->matrix[3 + i] = surf->vertices[1][i] - surf->vertices[0][i];
+	surf->extents[1] = sqrt(dot_product(surf->matrix + 3, surf->matrix + 3));
+	normalize(surf->matrix + 3);
+
+	/* z axis of matrix is the surface's normal */
+	cross_product(surf->matrix, surf->matrix + 3, surf->matrix + 6);
+
+	surf->texture = 0;
+	surface_reset(surf);
+}
+
+void
+surface_reset(struct surface *surf)
+{
+	float d, r = 0.0f;
+	int i, j;
+
+	/*
+	 * centered on the middle of the quad, reaching its farthest corner;
+	 * a little more so rounding can't leave a corner out
+	 */
+	for(i = 0; i < 3; i++)
+		surf->bounds[i] = (surf->vertices[0][i] + surf->vertices[1][i] +
+		                   surf->vertices[2][i] + surf->vertices[3][i]) * 0.25f;
+	for(j = 0; j < 4; j++) {
+		d = 0.0f;
+		for(i = 0; i < 3; i++)
+			d += (surf->vertices[j][i] - surf->bounds[i]) * (surf->vertices[j][i] - surf->bounds[i]);
+		if(d > r)
+			r = d;
+	}
+	surf->bounds[3] = sqrt(r) * 1.0001f + 1e-6f;
+
+	/* no lightmap has been computed yet */
+	surf->lightmap->page = -1;
+	surf->lightmap->x = surf->lightmap->y = 0;
+	surf->lightmap->width = surf->lightmap->height = LIGHTMAP_MIN_SIZE;
+	surf->lightmap->lod = 0;
+	for(j = 0; j < 4; j++)
+		surf->lightmap_coords[j][0] = surf->lightmap_coords[j][1] = 0.0f;
+	surf->lightmap_base = NULL;
+	surf->static_dist_sq = 0.0f;
+	for(i = 0; i < LIGHT_MASK_WORDS; i++)
+		surf->light_mask[i] = surf->light_reach[i] = 0;
+	surf->light_stamp = 0;
+}
+
+float
+surface_distance_sq(const struct surface *surf, const float p[3])
+{
+	float box_dist = 0.0f, plane_dist, len;
+	float min, max, d[3];
+	int i, j;
+
+	/* distance to the surface's bounding box */
+	for(i = 0; i < 3; i++) {
+		min = max = surf->vertices[0][i];
+		for(j = 1; j < 4; j++) {
+			if(surf->vertices[j][i] < min)
+				min = surf->vertices[j][i];
+			if(surf->vertices[j][i] > max)
+				max = surf->vertices[j][i];
+		}
+
+		if(p[i] < min)
+			box_dist += (min - p[i]) * (min - p[i]);
+		else if(p[i] > max)
+			box_dist += (p[i] - max) * (p[i] - max);
+	}
+
+	/* distance to the surface's plane */
+	for(i = 0; i < 3; i++)
+		d[i] = p[i] - surf->vertices[0][i];
+	plane_dist = dot_product(d, surf->matrix + 6);
+	len = dot_product(surf->matrix + 6, surf->matrix + 6);
+	plane_dist = len > 0.0f ? plane_dist * plane_dist / len : 0.0f;
+
+	/* both are lower bounds, so the larger one is the tighter bound */
+	return box_dist > plane_dist ? box_dist : plane_dist;
+}
+
+static unsigned int
+clamp_size(float texels)
+{
+	if(texels <= (float)LIGHTMAP_MIN_SIZE)
+		return LIGHTMAP_MIN_SIZE;
+	if(texels >= (float)LIGHTMAP_MAX_SIZE)
+		return LIGHTMAP_MAX_SIZE;
+	return (unsigned int)ceil(texels);
+}
+
+void
+surface_size_lightmap(struct surface *surf, float density)
+{
+	surf->lightmap->width = clamp_size(surf->extents[0] * density);
+	surf->lightmap->height = clamp_size(surf->extents[1] * density);
+}
+
+void
+surface_lod_size(const struct surface *surf, unsigned int lod,
+                 unsigned int *widthp, unsigned int *heightp)
+{
+	unsigned int round = (1u << lod) - 1;
+
+	/* round up so that every level still covers the whole surface */
+	*widthp = (surf->lightmap->width + round) >> lod;
+	*heightp = (surf->lightmap->height + round) >> lod;
+	if(*widthp < LIGHTMAP_MIN_SIZE)
+		*widthp = surf->lightmap->width < LIGHTMAP_MIN_SIZE ? surf->lightmap->width : LIGHTMAP_MIN_SIZE;
+	if(*heightp < LIGHTMAP_MIN_SIZE)
+		*heightp = surf->lightmap->height < LIGHTMAP_MIN_SIZE ? surf->lightmap->height : LIGHTMAP_MIN_SIZE;
+}
+
+void
+lightmap_add_base(const struct surface *surf, unsigned char *data,
+                  unsigned int width, unsigned int height, unsigned int pitch)
+{
+	const unsigned char *src;
+	unsigned char *out;
+	unsigned int i, j, x, sum;
+
+	for(i = 0; i < height; i++) {
+		out = data + i * pitch;
+		src = surf->lightmap_base + (i * surf->lightmap->height / height) * surf->lightmap->width * 3;
+
+		if(width == surf->lightmap->width) {
+			for(j = 0; j < width * 3; j++) {
+				sum = out[j] + src[j];
+				out[j] = (unsigned char)(sum > 255 ? 255 : sum);
+			}
+			continue;
+		}
+
+		/* lower levels take the nearest texel of the full size lightmap */
+		for(j = 0; j < width * 3; j++) {
+			x = (j / 3) * surf->lightmap->width / width * 3 + j % 3;
+			sum = out[j] + src[x];
+			out[j] = (unsigned char)(sum > 255 ? 255 : sum);
+		}
+	}
+}
+
+/*
+ * Reference texel loop; every texel is transformed into world space
+ * through the surface matrix. The SIMD kernels are checked against this.
+ */
+static void
+lightmap_compute_scalar(const struct surface *surf, const struct light *lights,
+                 unsigned int num_lights, unsigned char *data,
+                 unsigned int width, unsigned int height, unsigned int pitch)
+{
+	unsigned int i, j, k, c;
+	float pos[3], delta[3];
+	float s_step, t_step, s, t;
+
+	s_step = 1.0f / (float)width;
+	t_step = 1.0f / (float)height;
+
+	s = t = 0.0f;
+	for(i = 0; i < height; i++) {
+		for(j = 0; j < width; j++) {
+			float sum[3] = { 0.0f, 0.0f, 0.0f };
+
+			pos[0] = surf->extents[0] * s;
+			pos[1] = surf->extents[1] * t;
+			pos[2] = 0.0f;
+			multiply_vector_by_matrix(surf->matrix, pos);
+
+			pos[0] += surf->vertices[0][0];
+			pos[1] += surf->vertices[0][1];
+			pos[2] += surf->vertices[0][2];
+
+			for(k = 0; k < num_lights; k++) {
+				float d;
+				float tmp;
+
+				delta[0] = pos[0] - lights[k].pos[0];
+				delta[1] = pos[1] - lights[k].pos[1];
+				delta[2] = pos[2] - lights[k].pos[2];
+
+				d = dot_product(delta, delta) * 0.5f;
+				if(d < 1.0f)
+					d = 1.0f;
+				tmp = 1.0f / d;
+
+				sum[0] += 255.0f * tmp * lights[k].color[0];
+				sum[1] += 255.0f * tmp * lights[k].color[1];
+				sum[2] += 255.0f * tmp * lights[k].color[2];
+			}
+
+			for(c = 0; c < 3; c++) {
+				if(sum[c] > 255.0f)
+					sum[c] = 255.0f;
+				data[i * pitch + j * 3 + c] = (unsigned char)sum[c];
+			}
+
+			s += s_step;
+		}
+
+		t += t_step;
+		s = 0.0f;
+	}
+}
+
+/*
+ * The fixed point kernel looks up the intensity of a white light from
+ * half the squared distance, in steps of 1/FALLOFF_SCALE starting at 1.
+ * Beyond the end of the table it's less than one step of the output.
+ */
+#define FALLOFF_SCALE	256
+#define FALLOFF_SIZE	65536
+
+static unsigned char falloff[FALLOFF_SIZE];
+
+static void
+init_falloff()
+{
+	unsigned int i;
+
+	/* rounded, so that the error doesn't build up in one direction with many lights */
+	for(i = 0; i < FALLOFF_SIZE; i++)
+		falloff[i] = (unsigned char)(255.0f / (1.0f + ((float)i + 0.5f) / (float)FALLOFF_SCALE) + 0.5f);
+
+	/* everything past the end of the table is clamped to here */
+	falloff[FALLOFF_SIZE - 1] = 0;
+}
+
+/*
+ * Integer texel loop. Light colors are converted to 8.8 fixed point
+ * once, each light's contribution is the table intensity times that,
+ * and the contributions are summed into 8.8 accumulators that saturate
+ * at full brightness. 64 lights of the brightest color that fits can't
+ * overflow 32 bits before the saturation.
+ */
+static void
+lightmap_compute_fixed(const struct surface *surf, const struct light *lights,
+                       unsigned int num_lights, unsigned char *data,
+                       unsigned int width, unsigned int height, unsigned int pitch)
+{
+	unsigned int color[MAX_LIGHTS][3];
+	unsigned int i, j, k, c, index, sum[3];
+	float pos[3], s_step[3], t_step[3], dx, dy, dz, d;
+	unsigned char *out;
+
+	for(k = 0; k < num_lights; k++) {
+		for(c = 0; c < 3; c++) {
+			d = lights[k].color[c] * 256.0f + 0.5f;
+			color[k][c] = d >= 65535.0f ? 65535 : (unsigned int)d;
+		}
+	}
+
+	for(c = 0; c < 3; c++) {
+		s_step[c] = surf->matrix[0 + c] * surf->extents[0] / (float)width;
+		t_step[c] = surf->matrix[3 + c] * surf->extents[1] / (float)height;
+	}
+
+	for(i = 0; i < height; i++) {
+		out = data + i * pitch;
+		for(c = 0; c < 3; c++)
+			pos[c] = surf->vertices[0][c] + t_step[c] * (float)i;
+
+		for(j = 0; j < width; j++, out += 3) {
+			sum[0] = sum[1] = sum[2] = 0;
+
+			for(k = 0; k < num_lights; k++) {
+				dx = pos[0] - lights[k].pos[0];
+				dy = pos[1] - lights[k].pos[1];
+				dz = pos[2] - lights[k].pos[2];
+				d = ((dx * dx + dy * dy + dz * dz) * 0.5f - 1.0f) * (float)FALLOFF_SCALE;
+
+				/* the last entry is zero, so far away lights just add nothing */
+				d = d < 0.0f ? 0.0f : d;
+				d = d > (float)(FALLOFF_SIZE - 1) ? (float)(FALLOFF_SIZE - 1) : d;
+				index = (unsigned int)d;
+
+				sum[0] += falloff[index] * color[k][0];
+				sum[1] += falloff[index] * color[k][1];
+				sum[2] += falloff[index] * color[k][2];
+			}
+
+			/* nothing is negative, so saturating once is the same as after every add */
+			for(c = 0; c < 3; c++) {
+				if(sum[c] > 0xffff)
+					sum[c] = 0xffff;
+			}
+
+			out[0] = (unsigned char)(sum[0] >> 8);
+			out[1] = (unsigned char)(sum[1] >> 8);
+			out[2] = (unsigned char)(sum[2] >> 8);
+
+			pos[0] += s_step[0];
+			pos[1] += s_step[1];
+			pos[2] += s_step[2];
+		}
+	}
+}
+
+static int kernel = LIGHTMAP_KERNEL_SCALAR;
+static lightmap_kernel_func kernel_func = NULL;
+
+int
+lightmap_set_kernel(int k)
+{
+	if(k == LIGHTMAP_KERNEL_AUTO) {
+#ifdef LIGHTMAP_FIXED_POINT
+		return lightmap_set_kernel(LIGHTMAP_KERNEL_FIXED);
+#endif
+#ifdef HAVE_AVX2_KERNEL
+		if(lightmap_cpu_has_avx2())
+			return lightmap_set_kernel(LIGHTMAP_KERNEL_AVX2);
+#endif
+		return lightmap_set_kernel(LIGHTMAP_KERNEL_SSE2);
+	}
+
+	switch(k) {
+		default:
+			kernel = LIGHTMAP_KERNEL_SCALAR;
+			kernel_func = lightmap_compute_scalar;
+			break;
+		case LIGHTMAP_KERNEL_FIXED:
+			if(!falloff[0])
+				init_falloff();
+			kernel = k;
+			kernel_func = lightmap_compute_fixed;
+			break;
+#if defined(__SSE2__)
+		case LIGHTMAP_KERNEL_SSE2:
+			kernel = k;
+			kernel_func = lightmap_compute_sse2;
+			break;
+#endif
+#ifdef HAVE_AVX2_KERNEL
+		case LIGHTMAP_KERNEL_AVX2:
+			if(!lightmap_cpu_has_avx2())
+				return lightmap_set_kernel(LIGHTMAP_KERNEL_SSE2);
+			kernel = k;
+			kernel_func = lightmap_compute_avx2;
+			break;
+#endif
+	}
+
+	return kernel;
+}
+
+const char *
+lightmap_kernel_name(int k)
+{
+	switch(k) {
+		default:
+			return "unknown";
+		case LIGHTMAP_KERNEL_AUTO:
+			return "auto";
+		case LIGHTMAP_KERNEL_SCALAR:
+			return "scalar";
+		case LIGHTMAP_KERNEL_SSE2:
+			return "sse2";
+		case LIGHTMAP_KERNEL_AVX2:
+			return "avx2";
+		case LIGHTMAP_KERNEL_FIXED:
+			return "fixed";
+	}
+}
+
+void
+lightmap_compute(const struct surface *surf, const struct light *lights,
+                 unsigned int num_lights, unsigned char *data,
+                 unsigned int width, unsigned int height, unsigned int pitch)
+{
+	if(!kernel_func)
+		lightmap_set_kernel(LIGHTMAP_KERNEL_AUTO);
+
+	/* nothing reaches this surface */
+	if(num_lights == 0) {
+		unsigned int i;
+
+		for(i = 0; i < height; i++)
+			memset(data + i * pitch, 0, width * 3);
+		return;
+	}
+
+	kernel_func(surf, lights, num_lights, data, width, height, pitch);
+}
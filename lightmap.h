@@ -0,0 +1,147 @@
+/*
+ * Copyright (C) 2003 Josh A. Beam
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __LIGHTMAP_H__
+#define __LIGHTMAP_H__
+
+/*
+ * Lightmap resolution. Each surface gets LIGHTMAP_DENSITY texels per
+ * world unit along each axis, clamped to the min and max sizes; see
+ * surface_size_lightmap(). Each level of detail halves both sides.
+ */
+#define LIGHTMAP_DENSITY	8.0f
+#define LIGHTMAP_MIN_SIZE	2
+#define LIGHTMAP_MAX_SIZE	128
+#define LIGHTMAP_MAX_LOD	3
+
+#define MAX_LIGHTS		64
+#define LIGHT_MASK_WORDS	((MAX_LIGHTS + 31) / 32)
+
+/* where a surface's lightmap lives in the atlas */
+struct surface_lightmap {
+	int page;			/* -1 if it hasn't been placed yet */
+	unsigned int x, y;
+	unsigned int width, height;	/* full size of the atlas rectangle */
+	unsigned int lod;		/* level currently in the top left of the rectangle */
+};
+
+/*
+ * The geometry and lightmap placement of a surface point at its row of
+ * the arrays in a surface pool, which hold the only copy; see surfpool.h.
+ */
+struct surface {
+	float (*vertices)[3];		/* 4 corners */
+	float *matrix;			/* s axis, t axis, normal */
+	float *extents;			/* length along the s and t axes */
+	float *bounds;			/* bounding sphere center and radius */
+	struct surface_lightmap *lightmap;
+
+	int texture;			/* index into the scene's texture list */
+
+	/* static lights baked at full size, NULL if none reach the surface; see bake.h */
+	unsigned char *lightmap_base;
+	float static_dist_sq;		/* to the nearest of those lights */
+	float lightmap_coords[4][2];	/* per-vertex atlas texture coordinates */
+
+	/* lightmap cache; see light_surface_changed() */
+	unsigned int light_mask[LIGHT_MASK_WORDS];
+	unsigned long light_stamp;
+
+	/* lights within reach, when a spatial index keeps track; see lightgrid.h */
+	unsigned int light_reach[LIGHT_MASK_WORDS];
+};
+
+/* light flags */
+#define LIGHT_STATIC	0x1	/* never moves */
+
+struct light {
+	float pos[3];
+	float color[3];
+	float radius;
+	unsigned int flags;
+};
+
+/* texel loops that lightmap_compute() can use */
+#define LIGHTMAP_KERNEL_AUTO	0
+#define LIGHTMAP_KERNEL_SCALAR	1
+#define LIGHTMAP_KERNEL_SSE2	2
+#define LIGHTMAP_KERNEL_AVX2	3
+#define LIGHTMAP_KERNEL_FIXED	4	/* integer, with a falloff lookup table */
+#define LIGHTMAP_NUM_KERNELS	5
+
+/* surf's pointers must already lead somewhere; see surfpool_alloc() */
+void surface_init(struct surface *surf, float vertices[4][3]);
+
+/*
+ * Computes the bounding sphere and clears the lightmap state of a
+ * surface whose vertices, matrix and extents have been filled in some
+ * other way, such as from a scene file.
+ */
+void surface_reset(struct surface *surf);
+
+/*
+ * Returns a lower bound on the squared distance from p to any point
+ * on surf.
+ */
+float surface_distance_sq(const struct surface *surf, const float p[3]);
+
+/*
+ * Sets the full lightmap size of surf from its dimensions and the given
+ * number of texels per world unit.
+ */
+void surface_size_lightmap(struct surface *surf, float density);
+
+/* returns the width and height of surf's lightmap at the given level of detail */
+void surface_lod_size(const struct surface *surf, unsigned int lod,
+                      unsigned int *widthp, unsigned int *heightp);
+
+/*
+ * Computes a width x height RGB lightmap for surf lit by the given
+ * lights and stores it in data, with pitch bytes between the start of
+ * each row. This doesn't touch GL, so it can be run without a window.
+ */
+void lightmap_compute(const struct surface *surf, const struct light *lights,
+                      unsigned int num_lights, unsigned char *data,
+                      unsigned int width, unsigned int height, unsigned int pitch);
+
+/*
+ * Adds surf's baked lightmap_base, scaled down to width x height if
+ * the surface is at a lower level of detail, to the lightmap in data,
+ * saturating at full brightness.
+ */
+void lightmap_add_base(const struct surface *surf, unsigned char *data,
+                       unsigned int width, unsigned int height, unsigned int pitch);
+
+/*
+ * Selects the texel loop used by lightmap_compute(). LIGHTMAP_KERNEL_AUTO
+ * picks the fastest floating point one the CPU supports, or the fixed
+ * point one if LIGHTMAP_FIXED_POINT is defined. Returns the kernel that is now
+ * in use, which is LIGHTMAP_KERNEL_SCALAR if the requested one isn't
+ * available.
+ */
+int lightmap_set_kernel(int kernel);
+const char *lightmap_kernel_name(int kernel);
+
+#endif /* __LIGHTMAP_H__ */
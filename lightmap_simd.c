@@ -0,0 +1,502 @@
+/*
+ * Copyright (C) 2003 Josh A. Beam
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * SSE2 and AVX2 versions of the lightmap texel loop. Rather than running
+ * every texel through the surface matrix, each light is moved into the
+ * surface's s/t/normal basis once. Since every texel lies on the plane,
+ * the squared distance is then the sum of a term that only depends on
+ * the column and one that only depends on the row, and both are kept in
+ * tables. Surfaces whose s and t axes aren't at right angles instead
+ * have the world position of the first texel in each row computed once
+ * and stepped along the s axis. Either way four (SSE2) or eight (AVX2)
+ * texels are done at a time.
+ */
+
+#if defined(__SSE2__)
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <immintrin.h>
+#include "lightmap.h"
+
+struct row_setup {
+	float origin[3];	/* world position of texel 0 in row 0 */
+	float s_step[3];	/* world space distance between two texels in s */
+	float t_step[3];	/* world space distance between two rows */
+};
+
+/* the largest vector width, so that whole vectors can be read from the tables */
+#define TABLE_ALIGN	8
+
+struct light_tables {
+	float cols[MAX_LIGHTS][LIGHTMAP_MAX_SIZE + TABLE_ALIGN];	/* (s - s0)^2 / 2 */
+	float rows[MAX_LIGHTS][LIGHTMAP_MAX_SIZE];	/* ((t - t0)^2 + h^2) / 2 */
+	float color[MAX_LIGHTS][3];			/* premultiplied by 255 */
+};
+
+/* too big for the stack, so each thread allocates its own once */
+static pthread_key_t tables_key;
+static pthread_once_t tables_once = PTHREAD_ONCE_INIT;
+
+static void
+create_tables_key()
+{
+	pthread_key_create(&tables_key, free);
+}
+
+/* returns the calling thread's tables, or NULL if they can't be allocated */
+static struct light_tables *
+thread_tables()
+{
+	struct light_tables *lt;
+
+	pthread_once(&tables_once, create_tables_key);
+	if(!(lt = pthread_getspecific(tables_key))) {
+		if(!(lt = malloc(sizeof(struct light_tables))))
+			return NULL;
+		pthread_setspecific(tables_key, lt);
+	}
+
+	return lt;
+}
+
+/*
+ * Fills in the distance tables for the given lights. Returns 0 if the
+ * surface can't be done this way, in which case the tables are unused.
+ */
+static int
+setup_tables(const struct surface *surf, const struct light *lights,
+             unsigned int num_lights, unsigned int width, unsigned int height,
+             struct light_tables *lt)
+{
+	const float *s_axis = surf->matrix, *t_axis = surf->matrix + 3;
+	float s_step, t_step, l[3], s0, t0, h2, d;
+	unsigned int i, k;
+
+	if(!lt || width > LIGHTMAP_MAX_SIZE || height > LIGHTMAP_MAX_SIZE)
+		return 0;
+	d = s_axis[0] * t_axis[0] + s_axis[1] * t_axis[1] + s_axis[2] * t_axis[2];
+	if(d > 1e-4f || d < -1e-4f)
+		return 0;
+
+	s_step = surf->extents[0] / (float)width;
+	t_step = surf->extents[1] / (float)height;
+
+	for(k = 0; k < num_lights; k++) {
+		for(i = 0; i < 3; i++) {
+			l[i] = lights[k].pos[i] - surf->vertices[0][i];
+			lt->color[k][i] = 255.0f * lights[k].color[i];
+		}
+
+		/* whatever isn't along s or t is the height above the plane */
+		s0 = l[0] * s_axis[0] + l[1] * s_axis[1] + l[2] * s_axis[2];
+		t0 = l[0] * t_axis[0] + l[1] * t_axis[1] + l[2] * t_axis[2];
+		h2 = l[0] * l[0] + l[1] * l[1] + l[2] * l[2] - s0 * s0 - t0 * t0;
+		if(h2 < 0.0f)
+			h2 = 0.0f;
+
+		/* the padding past width only ever lands in texels that aren't stored */
+		for(i = 0; i < width + TABLE_ALIGN; i++) {
+			d = s_step * (float)i - s0;
+			lt->cols[k][i] = d * d * 0.5f;
+		}
+		for(i = 0; i < height; i++) {
+			d = t_step * (float)i - t0;
+			lt->rows[k][i] = (d * d + h2) * 0.5f;
+		}
+	}
+
+	return 1;
+}
+
+/*
+ * Clamps four texels' sums to 255, truncates them to integers and
+ * interleaves them into 12 bytes of RGB, followed by 4 zero bytes.
+ */
+static __m128i
+pack_texels(__m128 r, __m128 g, __m128 b)
+{
+	__m128 max = _mm_set1_ps(255.0f);
+	__m128i zero = _mm_setzero_si128();
+	__m128i low_dwords = _mm_set_epi32(0, -1, 0, -1);
+	__m128i planar, rg, bz, rgbx, v;
+
+	/*
+	 * r0..r3 g0..g3 b0..b3 0..0. The sums are clamped before converting,
+	 * since anything from 2^31 up converts to a negative number; the
+	 * saturating packs take care of the rest.
+	 */
+	planar = _mm_packus_epi16(_mm_packs_epi32(_mm_cvttps_epi32(_mm_min_ps(r, max)),
+	                                          _mm_cvttps_epi32(_mm_min_ps(g, max))),
+	                          _mm_packs_epi32(_mm_cvttps_epi32(_mm_min_ps(b, max)), zero));
+
+	/* r0 g0 b0 0 r1 g1 b1 0 ... */
+	rg = _mm_unpacklo_epi8(planar, _mm_srli_si128(planar, 4));
+	bz = _mm_unpacklo_epi8(_mm_srli_si128(planar, 8), zero);
+	rgbx = _mm_unpacklo_epi16(rg, bz);
+
+	/* squeeze out the zero bytes: first within each half, then between them */
+	v = _mm_or_si128(_mm_and_si128(rgbx, low_dwords),
+	                 _mm_srli_epi64(_mm_andnot_si128(low_dwords, rgbx), 8));
+	return _mm_or_si128(_mm_move_epi64(v), _mm_slli_si128(_mm_srli_si128(v, 8), 6));
+}
+
+/* stores the first count of four texels packed by pack_texels() */
+static void
+store_texels(unsigned char *out, __m128i texels, unsigned int count)
+{
+	unsigned char tmp[16];
+	int last;
+
+	if(count == 4) {
+		_mm_storel_epi64((__m128i *)out, texels);
+		last = _mm_cvtsi128_si32(_mm_srli_si128(texels, 8));
+		memcpy(out + 8, &last, 4);
+	} else {
+		_mm_storeu_si128((__m128i *)tmp, texels);
+		memcpy(out, tmp, count * 3);
+	}
+}
+
+static void
+setup_rows(const struct surface *surf, unsigned int width, unsigned int height,
+           struct row_setup *rs)
+{
+	float s_step = 1.0f / (float)width;
+	float t_step = 1.0f / (float)height;
+	int i;
+
+	for(i = 0; i < 3; i++) {
+		rs->origin[i] = surf->vertices[0][i];
+		rs->s_step[i] = surf->matrix[0 + i] * surf->extents[0] * s_step;
+		rs->t_step[i] = surf->matrix[3 + i] * surf->extents[1] * t_step;
+	}
+}
+
+/* computes a single texel; used for the end of rows that aren't a multiple of the vector width */
+static void
+compute_texel(const float pos[3], const struct light *lights,
+              unsigned int num_lights, unsigned char *out)
+{
+	float sum[3] = { 0.0f, 0.0f, 0.0f };
+	unsigned int k, c;
+
+	for(k = 0; k < num_lights; k++) {
+		float dx = pos[0] - lights[k].pos[0];
+		float dy = pos[1] - lights[k].pos[1];
+		float dz = pos[2] - lights[k].pos[2];
+		float d = (dx * dx + dy * dy + dz * dz) * 0.5f;
+
+		if(d < 1.0f)
+			d = 1.0f;
+		d = 1.0f / d;
+		for(c = 0; c < 3; c++)
+			sum[c] += d * (255.0f * lights[k].color[c]);
+	}
+
+	for(c = 0; c < 3; c++)
+		out[c] = (unsigned char)(sum[c] > 255.0f ? 255.0f : sum[c]);
+}
+
+static void
+compute_tail(const struct row_setup *rs, const float row[3], unsigned int j,
+             unsigned int width, const struct light *lights,
+             unsigned int num_lights, unsigned char *out)
+{
+	float pos[3];
+
+	for(; j < width; j++) {
+		pos[0] = row[0] + rs->s_step[0] * (float)j;
+		pos[1] = row[1] + rs->s_step[1] * (float)j;
+		pos[2] = row[2] + rs->s_step[2] * (float)j;
+		compute_texel(pos, lights, num_lights, out + j * 3);
+	}
+}
+
+static void
+separable_sse2(const struct light_tables *lt, unsigned int num_lights,
+               unsigned char *data, unsigned int width, unsigned int height,
+               unsigned int pitch)
+{
+	unsigned int i, j, k;
+	__m128 one;
+
+	one = _mm_set1_ps(1.0f);
+
+	for(i = 0; i < height; i++) {
+		unsigned char *out = data + i * pitch;
+
+		for(j = 0; j < width; j += 4) {
+			__m128 sr = _mm_setzero_ps();
+			__m128 sg = _mm_setzero_ps();
+			__m128 sb = _mm_setzero_ps();
+
+			for(k = 0; k < num_lights; k++) {
+				__m128 d = _mm_add_ps(_mm_loadu_ps(lt->cols[k] + j), _mm_set1_ps(lt->rows[k][i]));
+
+				d = _mm_div_ps(one, _mm_max_ps(d, one));
+				sr = _mm_add_ps(sr, _mm_mul_ps(d, _mm_set1_ps(lt->color[k][0])));
+				sg = _mm_add_ps(sg, _mm_mul_ps(d, _mm_set1_ps(lt->color[k][1])));
+				sb = _mm_add_ps(sb, _mm_mul_ps(d, _mm_set1_ps(lt->color[k][2])));
+			}
+
+			store_texels(out + j * 3, pack_texels(sr, sg, sb), width - j < 4 ? width - j : 4);
+		}
+	}
+}
+
+void
+lightmap_compute_sse2(const struct surface *surf, const struct light *lights,
+                      unsigned int num_lights, unsigned char *data,
+                      unsigned int width, unsigned int height, unsigned int pitch)
+{
+	struct row_setup rs;
+	struct light_tables *lt = thread_tables();
+	unsigned int i, j, k;
+	float row[3];
+	__m128 lane, one, half;
+
+	if(setup_tables(surf, lights, num_lights, width, height, lt)) {
+		separable_sse2(lt, num_lights, data, width, height, pitch);
+		return;
+	}
+
+	setup_rows(surf, width, height, &rs);
+	lane = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+	one = _mm_set1_ps(1.0f);
+	half = _mm_set1_ps(0.5f);
+
+	for(i = 0; i < height; i++) {
+		unsigned char *out = data + i * pitch;
+		__m128 x, y, z, dx4, dy4, dz4;
+
+		for(k = 0; k < 3; k++)
+			row[k] = rs.origin[k] + rs.t_step[k] * (float)i;
+
+		x = _mm_add_ps(_mm_set1_ps(row[0]), _mm_mul_ps(lane, _mm_set1_ps(rs.s_step[0])));
+		y = _mm_add_ps(_mm_set1_ps(row[1]), _mm_mul_ps(lane, _mm_set1_ps(rs.s_step[1])));
+		z = _mm_add_ps(_mm_set1_ps(row[2]), _mm_mul_ps(lane, _mm_set1_ps(rs.s_step[2])));
+		dx4 = _mm_set1_ps(rs.s_step[0] * 4.0f);
+		dy4 = _mm_set1_ps(rs.s_step[1] * 4.0f);
+		dz4 = _mm_set1_ps(rs.s_step[2] * 4.0f);
+
+		for(j = 0; j + 4 <= width; j += 4) {
+			__m128 sr = _mm_setzero_ps();
+			__m128 sg = _mm_setzero_ps();
+			__m128 sb = _mm_setzero_ps();
+
+			for(k = 0; k < num_lights; k++) {
+				__m128 lx = _mm_sub_ps(x, _mm_set1_ps(lights[k].pos[0]));
+				__m128 ly = _mm_sub_ps(y, _mm_set1_ps(lights[k].pos[1]));
+				__m128 lz = _mm_sub_ps(z, _mm_set1_ps(lights[k].pos[2]));
+				__m128 d;
+
+				d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(lx, lx), _mm_mul_ps(ly, ly)), _mm_mul_ps(lz, lz));
+				d = _mm_max_ps(_mm_mul_ps(d, half), one);
+				d = _mm_div_ps(one, d);
+
+				sr = _mm_add_ps(sr, _mm_mul_ps(d, _mm_set1_ps(255.0f * lights[k].color[0])));
+				sg = _mm_add_ps(sg, _mm_mul_ps(d, _mm_set1_ps(255.0f * lights[k].color[1])));
+				sb = _mm_add_ps(sb, _mm_mul_ps(d, _mm_set1_ps(255.0f * lights[k].color[2])));
+			}
+
+			store_texels(out + j * 3, pack_texels(sr, sg, sb), 4);
+
+			x = _mm_add_ps(x, dx4);
+			y = _mm_add_ps(y, dy4);
+			z = _mm_add_ps(z, dz4);
+		}
+
+		compute_tail(&rs, row, j, width, lights, num_lights, out);
+	}
+}
+
+#ifdef __GNUC__
+
+int
+lightmap_cpu_has_avx2()
+{
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2") ? 1 : 0;
+}
+
+/*
+ * pack_texels() for eight texels, into 24 bytes of RGB followed by 8
+ * zero bytes. Each 128-bit lane packs its own four texels the same way,
+ * then the two 12-byte runs are moved together.
+ */
+__attribute__((target("avx2")))
+static __m256i
+pack_texels8(__m256 r, __m256 g, __m256 b)
+{
+	__m256 max = _mm256_set1_ps(255.0f);
+	__m256i zero = _mm256_setzero_si256();
+	__m256i low_dwords = _mm256_set_epi32(0, -1, 0, -1, 0, -1, 0, -1);
+	__m256i low_qwords = _mm256_set_epi64x(0, -1, 0, -1);
+	__m256i planar, rg, bz, rgbx, v;
+
+	planar = _mm256_packus_epi16(_mm256_packs_epi32(_mm256_cvttps_epi32(_mm256_min_ps(r, max)),
+	                                                _mm256_cvttps_epi32(_mm256_min_ps(g, max))),
+	                             _mm256_packs_epi32(_mm256_cvttps_epi32(_mm256_min_ps(b, max)), zero));
+
+	rg = _mm256_unpacklo_epi8(planar, _mm256_srli_si256(planar, 4));
+	bz = _mm256_unpacklo_epi8(_mm256_srli_si256(planar, 8), zero);
+	rgbx = _mm256_unpacklo_epi16(rg, bz);
+
+	v = _mm256_or_si256(_mm256_and_si256(rgbx, low_dwords),
+	                    _mm256_srli_epi64(_mm256_andnot_si256(low_dwords, rgbx), 8));
+	v = _mm256_or_si256(_mm256_and_si256(v, low_qwords),
+	                    _mm256_slli_si256(_mm256_srli_si256(v, 8), 6));
+
+	/* the first three dwords of each lane, one after the other */
+	return _mm256_permutevar8x32_epi32(v, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7));
+}
+
+/* stores the first count of eight texels packed by pack_texels8() */
+__attribute__((target("avx2")))
+static void
+store_texels8(unsigned char *out, __m256i texels, unsigned int count)
+{
+	unsigned char tmp[32];
+
+	if(count == 8) {
+		_mm_storeu_si128((__m128i *)out, _mm256_castsi256_si128(texels));
+		_mm_storel_epi64((__m128i *)(out + 16), _mm256_extracti128_si256(texels, 1));
+	} else {
+		_mm256_storeu_si256((__m256i *)tmp, texels);
+		memcpy(out, tmp, count * 3);
+	}
+}
+
+__attribute__((target("avx2")))
+static void
+separable_avx2(const struct light_tables *lt, unsigned int num_lights,
+               unsigned char *data, unsigned int width, unsigned int height,
+               unsigned int pitch)
+{
+	unsigned int i, j, k;
+	__m256 one;
+
+	one = _mm256_set1_ps(1.0f);
+
+	for(i = 0; i < height; i++) {
+		unsigned char *out = data + i * pitch;
+
+		for(j = 0; j < width; j += 8) {
+			__m256 sr = _mm256_setzero_ps();
+			__m256 sg = _mm256_setzero_ps();
+			__m256 sb = _mm256_setzero_ps();
+
+			for(k = 0; k < num_lights; k++) {
+				__m256 d = _mm256_add_ps(_mm256_loadu_ps(lt->cols[k] + j), _mm256_set1_ps(lt->rows[k][i]));
+
+				d = _mm256_div_ps(one, _mm256_max_ps(d, one));
+				sr = _mm256_add_ps(sr, _mm256_mul_ps(d, _mm256_set1_ps(lt->color[k][0])));
+				sg = _mm256_add_ps(sg, _mm256_mul_ps(d, _mm256_set1_ps(lt->color[k][1])));
+				sb = _mm256_add_ps(sb, _mm256_mul_ps(d, _mm256_set1_ps(lt->color[k][2])));
+			}
+
+			store_texels8(out + j * 3, pack_texels8(sr, sg, sb), width - j < 8 ? width - j : 8);
+		}
+	}
+}
+
+__attribute__((target("avx2")))
+void
+lightmap_compute_avx2(const struct surface *surf, const struct light *lights,
+                      unsigned int num_lights, unsigned char *data,
+                      unsigned int width, unsigned int height, unsigned int pitch)
+{
+	struct row_setup rs;
+	struct light_tables *lt = thread_tables();
+	unsigned int i, j, k;
+	float row[3];
+	__m256 lane, one, half;
+
+	if(setup_tables(surf, lights, num_lights, width, height, lt)) {
+		separable_avx2(lt, num_lights, data, width, height, pitch);
+		return;
+	}
+
+	setup_rows(surf, width, height, &rs);
+	lane = _mm256_set_ps(7.0f, 6.0f, 5.0f, 4.0f, 3.0f, 2.0f, 1.0f, 0.0f);
+	one = _mm256_set1_ps(1.0f);
+	half = _mm256_set1_ps(0.5f);
+
+	for(i = 0; i < height; i++) {
+		unsigned char *out = data + i * pitch;
+		__m256 x, y, z, dx8, dy8, dz8;
+
+		for(k = 0; k < 3; k++)
+			row[k] = rs.origin[k] + rs.t_step[k] * (float)i;
+
+		x = _mm256_add_ps(_mm256_set1_ps(row[0]), _mm256_mul_ps(lane, _mm256_set1_ps(rs.s_step[0])));
+		y = _mm256_add_ps(_mm256_set1_ps(row[1]), _mm256_mul_ps(lane, _mm256_set1_ps(rs.s_step[1])));
+		z = _mm256_add_ps(_mm256_set1_ps(row[2]), _mm256_mul_ps(lane, _mm256_set1_ps(rs.s_step[2])));
+		dx8 = _mm256_set1_ps(rs.s_step[0] * 8.0f);
+		dy8 = _mm256_set1_ps(rs.s_step[1] * 8.0f);
+		dz8 = _mm256_set1_ps(rs.s_step[2] * 8.0f);
+
+		for(j = 0; j + 8 <= width; j += 8) {
+			__m256 sr = _mm256_setzero_ps();
+			__m256 sg = _mm256_setzero_ps();
+			__m256 sb = _mm256_setzero_ps();
+
+			for(k = 0; k < num_lights; k++) {
+				__m256 lx = _mm256_sub_ps(x, _mm256_set1_ps(lights[k].pos[0]));
+				__m256 ly = _mm256_sub_ps(y, _mm256_set1_ps(lights[k].pos[1]));
+				__m256 lz = _mm256_sub_ps(z, _mm256_set1_ps(lights[k].pos[2]));
+				__m256 d;
+
+				d = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(lx, lx), _mm256_mul_ps(ly, ly)), _mm256_mul_ps(lz, lz));
+				d = _mm256_max_ps(_mm256_mul_ps(d, half), one);
+				d = _mm256_div_ps(one, d);
+
+				sr = _mm256_add_ps(sr, _mm256_mul_ps(d, _mm256_set1_ps(255.0f * lights[k].color[0])));
+				sg = _mm256_add_ps(sg, _mm256_mul_ps(d, _mm256_set1_ps(255.0f * lights[k].color[1])));
+				sb = _mm256_add_ps(sb, _mm256_mul_ps(d, _mm256_set1_ps(255.0f * lights[k].color[2])));
+			}
+
+			store_texels8(out + j * 3, pack_texels8(sr, sg, sb), 8);
+
+			x = _mm256_add_ps(x, dx8);
+			y = _mm256_add_ps(y, dy8);
+			z = _mm256_add_ps(z, dz8);
+		}
+
+		compute_tail(&rs, row, j, width, lights, num_lights, out);
+	}
+}
+
+#endif /* __GNUC__ */
+
+#else
+
+/* ISO C doesn't allow an empty translation unit */
+typedef int lightmap_simd_unused;
+
+#endif /* __SSE2__ */
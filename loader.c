@@ -0,0 +1,234 @@
+/*
+ * Copyright (C) 2003 Josh A. Beam
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <GL/gl.h>
+#include "loader.h"
+#include "prof.h"
+
+extern unsigned char *read_pcx(const char *filename, unsigned int *widthp, unsigned int *heightp);
+
+struct load_job {
+	char *filename;
+	unsigned int tex;
+	double queued_at;
+
+	/* filled in by the loader thread; data is NULL if the file couldn't be read */
+	unsigned char *data;
+	unsigned int width, height;
+
+	struct load_job *next;
+};
+
+static pthread_t threads[LOADER_THREADS];
+static int num_threads = 0;
+
+/* jobs waiting for a thread, and decoded jobs waiting for loader_poll(); protected by lock */
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queue_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t done_cond = PTHREAD_COND_INITIALIZER;
+static struct load_job *queue_head = NULL, *queue_tail = NULL;
+static struct load_job *done_head = NULL;
+static unsigned int num_decoding = 0;	/* queued or being decoded */
+static unsigned int num_pending = 0;	/* not uploaded yet */
+
+/* latency statistics, only touched by the GL thread */
+static unsigned int num_loaded = 0;
+static double latency_sum = 0.0, latency_max = 0.0;
+
+static void *
+loader_thread(void *arg)
+{
+	struct load_job *job;
+
+	pthread_mutex_lock(&lock);
+	for(;;) {
+		while(!queue_head)
+			pthread_cond_wait(&queue_cond, &lock);
+		job = queue_head;
+		queue_head = job->next;
+		if(!queue_head)
+			queue_tail = NULL;
+		pthread_mutex_unlock(&lock);
+
+		job->data = read_pcx(job->filename, &job->width, &job->height);
+
+		pthread_mutex_lock(&lock);
+		job->next = done_head;
+		done_head = job;
+		num_decoding--;
+		pthread_cond_broadcast(&done_cond);
+	}
+
+	return NULL;
+}
+
+static void
+start_threads()
+{
+	int i;
+
+	for(i = 0; i < LOADER_THREADS; i++) {
+		if(pthread_create(&threads[i], NULL, loader_thread, NULL) != 0) {
+			fprintf(stderr, "Error: Couldn't create loader thread\n");
+			break;
+		}
+		pthread_detach(threads[i]);
+	}
+	num_threads = i;
+}
+
+static void
+set_texture(unsigned int tex, const unsigned char *data, unsigned int width, unsigned int height)
+{
+	glBindTexture(GL_TEXTURE_2D, tex);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexImage2D(GL_TEXTURE_2D, 0, 3, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
+}
+
+unsigned int
+loader_load_texture(const char *filename)
+{
+	static const unsigned char placeholder[3] = {
+		LOADER_PLACEHOLDER, LOADER_PLACEHOLDER, LOADER_PLACEHOLDER
+	};
+	struct load_job *job;
+	unsigned int tex;
+
+	glGenTextures(1, &tex);
+	set_texture(tex, placeholder, 1, 1);
+
+	job = malloc(sizeof(struct load_job));
+	if(job)
+		job->filename = malloc(strlen(filename) + 1);
+	if(!job || !job->filename) {
+		fprintf(stderr, "Error: Couldn't allocate memory to load %s\n", filename);
+		free(job);
+		return tex;
+	}
+	strcpy(job->filename, filename);
+	job->tex = tex;
+	job->queued_at = prof_time();
+	job->data = NULL;
+	job->next = NULL;
+
+	if(!num_threads)
+		start_threads();
+
+	/* without threads, decode it now and upload it on the next poll */
+	if(!num_threads)
+		job->data = read_pcx(job->filename, &job->width, &job->height);
+
+	pthread_mutex_lock(&lock);
+	if(!num_threads) {
+		job->next = done_head;
+		done_head = job;
+	} else {
+		if(queue_tail)
+			queue_tail->next = job;
+		else
+			queue_head = job;
+		queue_tail = job;
+		num_decoding++;
+		pthread_cond_signal(&queue_cond);
+	}
+	num_pending++;
+	pthread_mutex_unlock(&lock);
+
+	return tex;
+}
+
+void
+loader_poll()
+{
+	struct load_job *job, *next;
+	double latency;
+
+	pthread_mutex_lock(&lock);
+	job = done_head;
+	done_head = NULL;
+	pthread_mutex_unlock(&lock);
+
+	for(; job; job = next) {
+		next = job->next;
+
+		if(job->data) {
+			set_texture(job->tex, job->data, job->width, job->height);
+			latency = prof_time() - job->queued_at;
+			latency_sum += latency;
+			if(latency > latency_max)
+				latency_max = latency;
+			num_loaded++;
+		}
+
+		pthread_mutex_lock(&lock);
+		num_pending--;
+		pthread_mutex_unlock(&lock);
+
+		free(job->data);
+		free(job->filename);
+		free(job);
+	}
+}
+
+unsigned int
+loader_pending()
+{
+	unsigned int n;
+
+	pthread_mutex_lock(&lock);
+	n = num_pending;
+	pthread_mutex_unlock(&lock);
+
+	return n;
+}
+
+void
+loader_wait()
+{
+	pthread_mutex_lock(&lock);
+	while(num_decoding > 0)
+		pthread_cond_wait(&done_cond, &lock);
+	pthread_mutex_unlock(&lock);
+
+	loader_poll();
+}
+
+void
+loader_print_stats()
+{
+	if(num_loaded == 0)
+		return;
+
+	printf("Loaded %u texture(s), %.3f ms mean and %.3f ms max from queueing to upload\n",
+	       num_loaded, latency_sum * 1000.0 / num_loaded, latency_max * 1000.0);
+}
@@ -0,0 +1,57 @@
+/*
+ * Copyright (C) 2003 Josh A. Beam
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __LOADER_H__
+#define __LOADER_H__
+
+/*
+ * Loads textures in the background. Files are read and decoded on
+ * LOADER_THREADS threads of their own, and only the upload happens on
+ * the GL thread, from loader_poll(). Until then a texture holds a 1x1
+ * placeholder, so nothing waits on the disk before the first frame.
+ */
+
+#define LOADER_THREADS		2
+#define LOADER_PLACEHOLDER	128	/* gray level of the placeholder */
+
+/*
+ * Creates a texture holding the placeholder and queues filename to be
+ * loaded into it. Returns the GL texture name.
+ */
+unsigned int loader_load_texture(const char *filename);
+
+/* uploads every texture that has finished decoding; call on the GL thread */
+void loader_poll();
+
+/* returns how many textures are queued, decoding or waiting for upload */
+unsigned int loader_pending();
+
+/* blocks until everything queued has been decoded and uploaded */
+void loader_wait();
+
+/* prints the number of textures loaded and their latency from queueing to upload */
+void loader_print_stats();
+
+#endif /* __LOADER_H__ */
@@ -24,19 +24,49 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <GL/gl.h>
 #include <GL/glu.h>
 #include <GL/glut.h>
+#include "sched.h"
 
 #define WINWIDTH	400
 #define WINHEIGHT	300
 
 extern void scene_toggle_lighting();
+extern void scene_toggle_threads();
+extern void scene_toggle_geometry();
+extern void scene_toggle_upload();
+extern void scene_toggle_shader();
+extern void scene_toggle_shadows();
+extern void scene_toggle_backface_culling();
+extern void scene_bench_draw(unsigned int count, unsigned int frames);
+extern void scene_set_file(const char *filename);
+extern void scene_set_swap_func(void (*swap)());
+extern void scene_set_lightmap_density(float density);
+extern void scene_set_lightmap_budget(unsigned int usec);
+extern void scene_dump_profile();
 extern void scene_render();
-extern void scene_cycle();
+extern void scene_update(float seconds);
+extern void scene_interpolate(float alpha);
 
 static int window;
 
+void
+display()
+{
+	scene_interpolate(sched_alpha());
+	scene_render();
+}
+
+void
+idle()
+{
+	if(sched_idle())
+		glutPostRedisplay();
+}
+
 void
 key_press(unsigned char key, int x, int y)
 {
@@ -44,6 +74,27 @@ key_press(unsigned char key, int x, int y)
 		default:
 			scene_toggle_lighting();
 			break;
+		case 't':
+			scene_toggle_threads();
+			break;
+		case 'v':
+			scene_toggle_geometry();
+			break;
+		case 'g':
+			scene_toggle_shader();
+			break;
+		case 'u':
+			scene_toggle_upload();
+			break;
+		case 's':
+			scene_toggle_shadows();
+			break;
+		case 'b':
+			scene_toggle_backface_culling();
+			break;
+		case 'p':
+			scene_dump_profile();
+			break;
 		case 27: /* escape */
 			glutDestroyWindow(window);
 			exit(0);
@@ -54,6 +105,17 @@ key_press(unsigned char key, int x, int y)
 int
 main(int argc, char *argv[])
 {
+	/*
+	 * "main -simulate" runs the animation's fixed updates without a
+	 * window or GL, sleeping in between, until it's killed
+	 */
+	if(argc > 1 && strcmp(argv[1], "-simulate") == 0) {
+		sched_init(scene_update);
+		sched_set_simulate_only(1);
+		for(;;)
+			sched_idle();
+	}
+
 	glutInit(&argc, argv);
 	glutInitDisplayMode(GLUT_RGBA | GLUT_DOUBLE | GLUT_DEPTH);
 	glutInitWindowSize(WINWIDTH, WINHEIGHT);
@@ -63,8 +125,9 @@ main(int argc, char *argv[])
 	glutFullScreen();
 #endif
 
-	glutDisplayFunc(scene_render);
-	glutIdleFunc(scene_cycle);
+	scene_set_swap_func(glutSwapBuffers);
+	glutDisplayFunc(display);
+	glutIdleFunc(idle);
 	glutKeyboardFunc(key_press);
 
 	/* GL settings */
@@ -80,6 +143,39 @@ main(int argc, char *argv[])
 	gluPerspective(45.0f, (float)WINWIDTH / (float)WINHEIGHT, 0.1f, 200.0f);
 	glMatrixMode(GL_MODELVIEW);
 
+	/* "main -benchdraw n" times drawing n surfaces and exits */
+	if(argc > 2 && strcmp(argv[1], "-benchdraw") == 0) {
+		scene_bench_draw(atoi(argv[2]), 100);
+		return 0;
+	}
+	for(; argc > 1 && argv[1][0] == '-'; argc--, argv++) {
+		if(argc > 2 && strcmp(argv[1], "-density") == 0) {
+			/* "main -density n" sets the lightmap texels per world unit */
+			scene_set_lightmap_density((float)atof(argv[2]));
+			argc--;
+			argv++;
+		} else if(argc > 2 && strcmp(argv[1], "-budget") == 0) {
+			/* "main -budget us" limits the time spent on lightmaps each frame */
+			scene_set_lightmap_budget(atoi(argv[2]));
+			argc--;
+			argv++;
+		} else if(argc > 2 && strcmp(argv[1], "-fps") == 0) {
+			/* "main -fps n" caps the frame rate, or doesn't with 0 */
+			sched_set_frame_cap((float)atof(argv[2]));
+			argc--;
+			argv++;
+		} else {
+			break;
+		}
+	}
+	if(argc > 1 && argv[1][0] != '-')
+		scene_set_file(argv[1]);
+
+	/* write the frame statistics out when we quit */
+	atexit(scene_dump_profile);
+
+	sched_init(scene_update);
+
 	glutMainLoop();
 	return 0;
 }
@@ -0,0 +1,205 @@
+/*
+ * Copyright (C) 2003 Josh A. Beam
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Converts a text scene description into a binary scene file.
+ *
+ * Each line of the input is one of:
+ *
+ *   texture <filename>
+ *   surface <texture> <x y z> <x y z> <x y z> <x y z>
+ *   light <x y z> <r g b> <radius> [static]
+ *
+ * where <texture> is the index of a texture line, counting from 0, and
+ * blank lines and lines starting with # are ignored.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "scenefile.h"
+
+static struct scenefile_texture *textures = NULL;
+static struct scenefile_surface *surfaces = NULL;
+static struct scenefile_light *lights = NULL;
+static unsigned int num_textures = 0, num_surfaces = 0, num_lights = 0;
+
+/* grows an array by one element, returning a pointer to the new element */
+static void *
+grow(void **array, unsigned int *count, size_t size)
+{
+	void *p = realloc(*array, size * (*count + 1));
+
+	if(!p) {
+		fprintf(stderr, "Error: Out of memory\n");
+		exit(1);
+	}
+	*array = p;
+	memset((char *)p + size * *count, 0, size);
+
+	return (char *)p + size * (*count)++;
+}
+
+static void
+write_floats(float *out, const float *in, int n)
+{
+	int i;
+
+	for(i = 0; i < n; i++)
+		out[i] = native_to_le_float(in[i]);
+}
+
+static int
+parse_line(const char *line)
+{
+	char keyword[16], name[SCENEFILE_NAME_LEN], flag[16];
+	float v[4][3], color[3], radius;
+	unsigned int texture;
+	int n;
+
+	if(sscanf(line, "%15s", keyword) != 1 || keyword[0] == '#')
+		return 1;
+
+	if(strcmp(keyword, "texture") == 0) {
+		struct scenefile_texture *t;
+
+		if(sscanf(line, "%*s %63s", name) != 1)
+			return 0;
+		t = grow((void **)&textures, &num_textures, sizeof(struct scenefile_texture));
+		strcpy(t->name, name);
+	} else if(strcmp(keyword, "surface") == 0) {
+		struct scenefile_surface *s;
+		struct surface surf;
+		struct surface_lightmap lightmap;
+		float corners[4][3], matrix[9], extents[2], bounds[4];
+
+		n = sscanf(line, "%*s %u %f %f %f %f %f %f %f %f %f %f %f %f", &texture,
+		           &v[0][0], &v[0][1], &v[0][2], &v[1][0], &v[1][1], &v[1][2],
+		           &v[2][0], &v[2][1], &v[2][2], &v[3][0], &v[3][1], &v[3][2]);
+		if(n != 13)
+			return 0;
+		if(texture >= num_textures) {
+			fprintf(stderr, "Error: Surface uses texture %u, which hasn't been defined\n", texture);
+			return 0;
+		}
+
+		surf.vertices = corners;
+		surf.matrix = matrix;
+		surf.extents = extents;
+		surf.bounds = bounds;
+		surf.lightmap = &lightmap;
+		surface_init(&surf, v);
+		s = grow((void **)&surfaces, &num_surfaces, sizeof(struct scenefile_surface));
+		write_floats(s->vertices[0], surf.vertices[0], 12);
+		write_floats(s->matrix, surf.matrix, 9);
+		s->s_dist = native_to_le_float(surf.extents[0]);
+		s->t_dist = native_to_le_float(surf.extents[1]);
+		s->texture = native_to_le_uint(texture);
+	} else if(strcmp(keyword, "light") == 0) {
+		struct scenefile_light *l;
+
+		flag[0] = '\0';
+		n = sscanf(line, "%*s %f %f %f %f %f %f %f %15s", &v[0][0], &v[0][1], &v[0][2],
+		           &color[0], &color[1], &color[2], &radius, flag);
+		if(n < 7 || (n == 8 && strcmp(flag, "static") != 0))
+			return 0;
+
+		l = grow((void **)&lights, &num_lights, sizeof(struct scenefile_light));
+		write_floats(l->pos, v[0], 3);
+		write_floats(l->color, color, 3);
+		l->radius = native_to_le_float(radius);
+		l->flags = native_to_le_uint(n == 8 ? LIGHT_STATIC : 0);
+	} else {
+		return 0;
+	}
+
+	return 1;
+}
+
+int
+main(int argc, char *argv[])
+{
+	FILE *in, *out;
+	char line[512];
+	unsigned int line_num = 0;
+	struct scenefile_header header;
+	uint32_t offset;
+
+	if(argc != 3) {
+		fprintf(stderr, "usage: %s <input.txt> <output.dat>\n", argv[0]);
+		return 1;
+	}
+
+	in = fopen(argv[1], "r");
+	if(!in) {
+		fprintf(stderr, "Error: Couldn't open %s for reading\n", argv[1]);
+		return 1;
+	}
+	while(fgets(line, sizeof(line), in)) {
+		line_num++;
+		if(!parse_line(line)) {
+			fprintf(stderr, "%s:%u: Error: Invalid line\n", argv[1], line_num);
+			fclose(in);
+			return 1;
+		}
+	}
+	fclose(in);
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, SCENEFILE_MAGIC, 4);
+	header.version = native_to_le_uint(SCENEFILE_VERSION);
+	header.num_textures = native_to_le_uint(num_textures);
+	header.num_surfaces = native_to_le_uint(num_surfaces);
+	header.num_lights = native_to_le_uint(num_lights);
+	offset = sizeof(struct scenefile_header);
+	header.textures_offset = native_to_le_uint(offset);
+	offset += num_textures * sizeof(struct scenefile_texture);
+	header.surfaces_offset = native_to_le_uint(offset);
+	offset += num_surfaces * sizeof(struct scenefile_surface);
+	header.lights_offset = native_to_le_uint(offset);
+
+	out = fopen(argv[2], "wb");
+	if(!out) {
+		fprintf(stderr, "Error: Couldn't open %s for writing\n", argv[2]);
+		return 1;
+	}
+	if(fwrite(&header, sizeof(header), 1, out) != 1 ||
+	   fwrite(textures, sizeof(struct scenefile_texture), num_textures, out) != num_textures ||
+	   fwrite(surfaces, sizeof(struct scenefile_surface), num_surfaces, out) != num_surfaces ||
+	   fwrite(lights, sizeof(struct scenefile_light), num_lights, out) != num_lights) {
+		fprintf(stderr, "Error: Couldn't write %s\n", argv[2]);
+		fclose(out);
+		return 1;
+	}
+	fclose(out);
+
+	printf("%s: %u textures, %u surfaces, %u lights\n", argv[2],
+	       num_textures, num_surfaces, num_lights);
+
+	free(textures);
+	free(surfaces);
+	free(lights);
+	return 0;
+}
@@ -23,116 +23,175 @@
  * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
-#include <stdio.h>
 #include "my_endian.h"
 
-#ifndef UNKNOWN_ENDIAN
-#define UNKNOWN_ENDIAN	0
-#endif
-#ifndef LITTLE_ENDIAN
-#define LITTLE_ENDIAN	1
-#endif
-#ifndef BIG_ENDIAN
-#define BIG_ENDIAN		2
+#if defined(__SSE2__)
+#include <immintrin.h>
 #endif
 
-static uint32_t endian = UNKNOWN_ENDIAN;
+#if MY_BYTE_ORDER == MY_UNKNOWN_ENDIAN
+static int big_endian = -1;
 
-static uint32_t
-set_endian()
+static int
+is_big_endian()
 {
-	if(endian == UNKNOWN_ENDIAN) {
+	if(big_endian < 0) {
 		unsigned char c[] = { 1, 0 };
 		unsigned short *p = (unsigned short *)c;
 
-		if(*p == 1) {
-			endian = LITTLE_ENDIAN;
-			printf("Using little-endian byte ordering\n");
-		} else {
-			endian = BIG_ENDIAN;
-			printf("Using big-endian byte ordering\n");
-		}
+		big_endian = (*p != 1);
 	}
 
-	return endian;
+	return big_endian;
 }
+#define IS_BIG_ENDIAN	is_big_endian()
+#else
+#define IS_BIG_ENDIAN	(MY_BYTE_ORDER == MY_BIG_ENDIAN)
+#endif
 
-static float
-swap_float(float f)
+/* byte at a time, for the ends of buffers and hosts without SSE2 */
+static void
+swap_16_scalar(unsigned char *p, unsigned long count)
 {
-	float retval;
-	uint8_t *p1 = (uint8_t *)&f;
-	uint8_t *p2 = (uint8_t *)&retval;
+	unsigned char tmp;
 
-	p2[0] = p1[3];
-	p2[1] = p1[2];
-	p2[2] = p1[1];
-	p2[3] = p1[0];
+	for(; count > 0; count--, p += 2) {
+		tmp = p[0]; p[0] = p[1]; p[1] = tmp;
+	}
+}
+
+static void
+swap_32_scalar(unsigned char *p, unsigned long count)
+{
+	unsigned char tmp;
 
-	return retval;
+	for(; count > 0; count--, p += 4) {
+		tmp = p[0]; p[0] = p[3]; p[3] = tmp;
+		tmp = p[1]; p[1] = p[2]; p[2] = tmp;
+	}
 }
 
-static int32_t
-swap_int(int32_t i)
+#if defined(__SSE2__) && defined(__GNUC__)
+
+static int
+cpu_has_ssse3()
 {
-	int32_t retval;
-	uint8_t *p1 = (uint8_t *)&i;
-	uint8_t *p2 = (uint8_t *)&retval;
+	static int ssse3 = -1;
 
-	p2[0] = p1[3];
-	p2[1] = p1[2];
-	p2[2] = p1[1];
-	p2[3] = p1[0];
+	if(ssse3 < 0) {
+		__builtin_cpu_init();
+		ssse3 = __builtin_cpu_supports("ssse3") ? 1 : 0;
+	}
 
-	return retval;
+	return ssse3;
 }
 
-static uint32_t
-swap_uint(uint32_t i)
+/* one pshufb per 16 bytes, with the shuffle for the value size in mask */
+__attribute__((target("ssse3")))
+static unsigned long
+swap_ssse3(unsigned char *p, unsigned long bytes, __m128i mask)
 {
-	uint32_t retval;
-	uint8_t *p1 = (uint8_t *)&i;
-	uint8_t *p2 = (uint8_t *)&retval;
+	unsigned long i;
+	__m128i a, b;
+
+	for(i = 0; i + 32 <= bytes; i += 32) {
+		a = _mm_loadu_si128((const __m128i *)(p + i));
+		b = _mm_loadu_si128((const __m128i *)(p + i + 16));
+		_mm_storeu_si128((__m128i *)(p + i), _mm_shuffle_epi8(a, mask));
+		_mm_storeu_si128((__m128i *)(p + i + 16), _mm_shuffle_epi8(b, mask));
+	}
+	for(; i + 16 <= bytes; i += 16) {
+		a = _mm_loadu_si128((const __m128i *)(p + i));
+		_mm_storeu_si128((__m128i *)(p + i), _mm_shuffle_epi8(a, mask));
+	}
 
-	p2[0] = p1[3];
-	p2[1] = p1[2];
-	p2[2] = p1[1];
-	p2[3] = p1[0];
+	return i;
+}
+
+#endif /* __SSE2__ && __GNUC__ */
+
+#if defined(__SSE2__)
 
-	return retval;
+/* swaps the bytes of each 16 bit lane */
+static __m128i
+swap_lanes_16(__m128i v)
+{
+	return _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
 }
 
-static int16_t
-swap_short(int16_t s)
+/* SSE2 has no byte shuffle, so swap bytes within 16 bit lanes and then the lanes */
+static unsigned long
+swap_32_sse2(unsigned char *p, unsigned long bytes)
 {
-	int16_t retval;
-	uint8_t *p1 = (uint8_t *)&s;
-	uint8_t *p2 = (uint8_t *)&retval;
+	unsigned long i;
+	__m128i v;
 
-	p2[0] = p1[1];
-	p2[1] = p1[0];
+	for(i = 0; i + 16 <= bytes; i += 16) {
+		v = swap_lanes_16(_mm_loadu_si128((const __m128i *)(p + i)));
+		v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+		v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+		_mm_storeu_si128((__m128i *)(p + i), v);
+	}
 
-	return retval;
+	return i;
 }
 
-static uint16_t
-swap_ushort(uint16_t s)
+static unsigned long
+swap_16_sse2(unsigned char *p, unsigned long bytes)
 {
-	uint16_t retval;
-	uint8_t *p1 = (uint8_t *)&s;
-	uint8_t *p2 = (uint8_t *)&retval;
+	unsigned long i;
 
-	p2[0] = p1[1];
-	p2[1] = p1[0];
+	for(i = 0; i + 16 <= bytes; i += 16)
+		_mm_storeu_si128((__m128i *)(p + i), swap_lanes_16(_mm_loadu_si128((const __m128i *)(p + i))));
 
-	return retval;
+	return i;
 }
 
+#endif /* __SSE2__ */
+
+void
+swap_16_array(void *data, unsigned long count)
+{
+	unsigned char *p = (unsigned char *)data;
+	unsigned long done = 0;
+
+#if defined(__SSE2__) && defined(__GNUC__)
+	if(cpu_has_ssse3())
+		done = swap_ssse3(p, count * 2, _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14));
+	else
+		done = swap_16_sse2(p, count * 2);
+#elif defined(__SSE2__)
+	done = swap_16_sse2(p, count * 2);
+#endif
+
+	swap_16_scalar(p + done, count - done / 2);
+}
+
+void
+swap_32_array(void *data, unsigned long count)
+{
+	unsigned char *p = (unsigned char *)data;
+	unsigned long done = 0;
+
+#if defined(__SSE2__) && defined(__GNUC__)
+	if(cpu_has_ssse3())
+		done = swap_ssse3(p, count * 4, _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12));
+	else
+		done = swap_32_sse2(p, count * 4);
+#elif defined(__SSE2__)
+	done = swap_32_sse2(p, count * 4);
+#endif
+
+	swap_32_scalar(p + done, count - done / 4);
+}
+
+#if MY_BYTE_ORDER != MY_LITTLE_ENDIAN
+
 float
 le_to_native_float(float f)
 {
-	if(set_endian() == BIG_ENDIAN)
-		return swap_float(f);
+	if(IS_BIG_ENDIAN)
+		swap_32_scalar((unsigned char *)&f, 1);
 
 	return f;
 }
@@ -140,8 +199,8 @@ le_to_native_float(float f)
 int32_t
 le_to_native_int(int32_t i)
 {
-	if(set_endian() == BIG_ENDIAN)
-		return swap_int(i);
+	if(IS_BIG_ENDIAN)
+		swap_32_scalar((unsigned char *)&i, 1);
 
 	return i;
 }
@@ -149,8 +208,8 @@ le_to_native_int(int32_t i)
 uint32_t
 le_to_native_uint(uint32_t i)
 {
-	if(set_endian() == BIG_ENDIAN)
-		return swap_uint(i);
+	if(IS_BIG_ENDIAN)
+		swap_32_scalar((unsigned char *)&i, 1);
 
 	return i;
 }
@@ -158,8 +217,8 @@ le_to_native_uint(uint32_t i)
 int16_t
 le_to_native_short(int16_t s)
 {
-	if(set_endian() == BIG_ENDIAN)
-		return swap_short(s);
+	if(IS_BIG_ENDIAN)
+		swap_16_scalar((unsigned char *)&s, 1);
 
 	return s;
 }
@@ -167,8 +226,45 @@ le_to_native_short(int16_t s)
 uint16_t
 le_to_native_ushort(uint16_t s)
 {
-	if(set_endian() == BIG_ENDIAN)
-		return swap_ushort(s);
+	if(IS_BIG_ENDIAN)
+		swap_16_scalar((unsigned char *)&s, 1);
 
 	return s;
 }
+
+void
+le_to_native_float_array(float *data, unsigned long count)
+{
+	if(IS_BIG_ENDIAN)
+		swap_32_array(data, count);
+}
+
+void
+le_to_native_int_array(int32_t *data, unsigned long count)
+{
+	if(IS_BIG_ENDIAN)
+		swap_32_array(data, count);
+}
+
+void
+le_to_native_uint_array(uint32_t *data, unsigned long count)
+{
+	if(IS_BIG_ENDIAN)
+		swap_32_array(data, count);
+}
+
+void
+le_to_native_short_array(int16_t *data, unsigned long count)
+{
+	if(IS_BIG_ENDIAN)
+		swap_16_array(data, count);
+}
+
+void
+le_to_native_ushort_array(uint16_t *data, unsigned long count)
+{
+	if(IS_BIG_ENDIAN)
+		swap_16_array(data, count);
+}
+
+#endif /* MY_BYTE_ORDER != MY_LITTLE_ENDIAN */
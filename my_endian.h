@@ -26,29 +26,26 @@
 #ifndef __MY_ENDIAN_H__
 #define __MY_ENDIAN_H__
 
-#ifdef __GLIBC__
+/* the fixed sizes files are read and written with, whatever the host's ABI */
 #include <stdint.h>
-#else
-#include <sys/types.h>
-#endif
 
-#ifndef int8_t
- #define int8_t char
-#endif
-#ifndef uint8_t
- #define uint8_t unsigned char
-#endif
-#ifndef int16_t
- #define int16_t short
-#endif
-#ifndef uint16_t
- #define uint16_t unsigned short
-#endif
-#ifndef int32_t
- #define int32_t long
-#endif
-#ifndef uint32_t
- #define uint32_t unsigned long
+/*
+ * Files are little-endian. The host's byte order is found at compile time
+ * where the compiler tells us, which makes the conversions below free on
+ * little-endian hosts; otherwise it's checked once at run time.
+ */
+#define MY_UNKNOWN_ENDIAN	0
+#define MY_LITTLE_ENDIAN	1
+#define MY_BIG_ENDIAN		2
+
+#if defined(__BYTE_ORDER__) && defined(__ORDER_LITTLE_ENDIAN__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+ #define MY_BYTE_ORDER MY_LITTLE_ENDIAN
+#elif defined(__BYTE_ORDER__) && defined(__ORDER_BIG_ENDIAN__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+ #define MY_BYTE_ORDER MY_BIG_ENDIAN
+#elif defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
+ #define MY_BYTE_ORDER MY_LITTLE_ENDIAN
+#else
+ #define MY_BYTE_ORDER MY_UNKNOWN_ENDIAN
 #endif
 
 #define native_to_le_float le_to_native_float
@@ -57,10 +54,45 @@
 #define native_to_le_short le_to_native_short
 #define native_to_le_ushort le_to_native_ushort
 
+#define native_to_le_float_array le_to_native_float_array
+#define native_to_le_int_array le_to_native_int_array
+#define native_to_le_uint_array le_to_native_uint_array
+#define native_to_le_short_array le_to_native_short_array
+#define native_to_le_ushort_array le_to_native_ushort_array
+
+#if MY_BYTE_ORDER == MY_LITTLE_ENDIAN
+
+#define le_to_native_float(f) ((float)(f))
+#define le_to_native_int(i) ((int32_t)(i))
+#define le_to_native_uint(i) ((uint32_t)(i))
+#define le_to_native_short(s) ((int16_t)(s))
+#define le_to_native_ushort(s) ((uint16_t)(s))
+
+#define le_to_native_float_array(data, count) ((void)(data), (void)(count))
+#define le_to_native_int_array(data, count) ((void)(data), (void)(count))
+#define le_to_native_uint_array(data, count) ((void)(data), (void)(count))
+#define le_to_native_short_array(data, count) ((void)(data), (void)(count))
+#define le_to_native_ushort_array(data, count) ((void)(data), (void)(count))
+
+#else
+
 float le_to_native_float(float f);
 int32_t le_to_native_int(int32_t i);
 uint32_t le_to_native_uint(uint32_t i);
 int16_t le_to_native_short(int16_t s);
 uint16_t le_to_native_ushort(uint16_t s);
 
+/* convert count values in place */
+void le_to_native_float_array(float *data, unsigned long count);
+void le_to_native_int_array(int32_t *data, unsigned long count);
+void le_to_native_uint_array(uint32_t *data, unsigned long count);
+void le_to_native_short_array(int16_t *data, unsigned long count);
+void le_to_native_ushort_array(uint16_t *data, unsigned long count);
+
+#endif
+
+/* reverse the bytes of each of count 16 or 32 bit values in place, whatever the host */
+void swap_16_array(void *data, unsigned long count);
+void swap_32_array(void *data, unsigned long count);
+
 #endif /* __MY_ENDIAN_H__ */
@@ -25,6 +25,11 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "my_endian.h"
 
 struct pcx_header {
@@ -48,207 +53,191 @@ struct pcx_header {
 	uint8_t filler[54];
 };
 
+/* largest image we'll decode, to keep the output size from overflowing */
+#define MAX_PCX_DIMENSION	16384
+
+/*
+ * Decodes one RLE scanline of len bytes (all color planes of a line
+ * stored one after the other) from *p into line. Runs that would go past
+ * the end of the scanline are cut short. Returns 0 if the data runs out.
+ */
 static int
-read_scanline(FILE *fp, unsigned char *planes[], unsigned int num_planes,
-              unsigned int bytesperline)
+decode_scanline(const unsigned char **p, const unsigned char *end,
+                unsigned char *line, unsigned int len)
 {
-	unsigned int i, j;
-	unsigned int p, count;
-	uint8_t byte;
-
-	for(p = 0; p < num_planes; p++) {
-		for(i = 0; i < bytesperline;) {
-			if(fread(&byte, 1, 1, fp) != 1)
+	const unsigned char *in = *p;
+	unsigned int i = 0, count;
+	unsigned char byte;
+
+	while(i < len) {
+		if(in >= end)
+			return 0;
+		byte = *in++;
+
+		if((byte & 0xc0) == 0xc0) {
+			count = byte & 0x3f;
+			if(count == 0 || in >= end)
 				return 0;
-
-			if(byte >> 6 == 0x3) {
-				count = byte & ~(0x3 << 6);
-				if(count == 0)
-					return 0;
-				if(fread(&byte, 1, 1, fp) != 1)
-					return 0;
-			} else {
-				count = 1;
-			}
-
-			for(j = 0; j < count; j++)
-				planes[p][i++] = byte;
-
-			if(i >= bytesperline) {
-				p++;
-				if(p >= num_planes)
-					return 1;
-				i = 0;
-			}
+			byte = *in++;
+			if(count > len - i)
+				count = len - i;
+			memset(line + i, byte, count);
+			i += count;
+		} else {
+			line[i++] = byte;
 		}
 	}
 
+	*p = in;
 	return 1;
 }
 
-static unsigned char *
-load_pcx_data_8(FILE *fp, int width, int height,
-                unsigned int bytesperline)
+/*
+ * Decodes an image from a PCX file that has been read into memory.
+ * The palette of 8-bit images is applied as each line is decoded.
+ */
+unsigned char *
+read_pcx_mem(const unsigned char *buf, size_t size,
+             unsigned int *widthp, unsigned int *heightp)
 {
-	int i, j;
-	int max;
-	unsigned char *data, *p_data;
-	unsigned char *line, *planes[1];
-	unsigned int current_line = 0;
-	uint8_t byte;
-	unsigned char palette[256][3];
-
-	p_data = (unsigned char *)malloc(sizeof(unsigned char) * width * height);
-	if(!p_data)
+	struct pcx_header header;
+	const unsigned char *p, *end, *palette = NULL;
+	unsigned char *data, *out, *line;
+	unsigned int width, height, planes, bytesperline;
+	unsigned int x, y;
+	int xmin, ymin, xmax, ymax;
+
+	if(size < sizeof(struct pcx_header)) {
+		fprintf(stderr, "Error: PCX data is too small to hold a header\n");
 		return NULL;
+	}
+	memcpy(&header, buf, sizeof(struct pcx_header));
+	xmin = le_to_native_short(header.xmin);
+	ymin = le_to_native_short(header.ymin);
+	xmax = le_to_native_short(header.xmax);
+	ymax = le_to_native_short(header.ymax);
+	bytesperline = le_to_native_ushort(header.bytesperline);
+	planes = header.colorplanes;
 
-	line = (unsigned char *)malloc(sizeof(unsigned char) * bytesperline);
-	if(!line) {
-		free(p_data);
+	if(header.bitsperpixel != 8) {
+		fprintf(stderr, "Error: PCX image has unsupported number of bits per pixel\n");
 		return NULL;
 	}
-	planes[0] = line;
-
-	while(current_line < (unsigned int)height) {
-		if(read_scanline(fp, planes, 1, bytesperline) == 0) {
-			free(p_data);
-			free(line);
-			return NULL;
-		}
-
-		for(i = 0; i < width; i++)
-			p_data[width * current_line + i] = planes[0][i];
-
-		current_line++;
+	if(planes != 1 && planes != 3) {
+		fprintf(stderr, "Error: PCX image has unsupported number of color planes\n");
+		return NULL;
 	}
-
-	/* read palette */
-	fseek(fp, -769, SEEK_END);
-	fread(&byte, 1, 1, fp);
-	if(byte != 12) {
-		fprintf(stderr, "Error: This ain't a palette\n");
-		free(p_data);
-		free(line);
+	if(xmax < xmin || ymax < ymin || xmax - xmin + 1 > MAX_PCX_DIMENSION ||
+	   ymax - ymin + 1 > MAX_PCX_DIMENSION) {
+		fprintf(stderr, "Error: PCX image has bad dimensions (%dx%d)\n",
+		        xmax - xmin + 1, ymax - ymin + 1);
 		return NULL;
 	}
-	for(i = 0; i < 256; i++)
-		fread(palette[i], 3, 1, fp);
-
-	data = (unsigned char *)malloc(sizeof(unsigned char) * width * height * 3);
-	if(!data) {
-		free(p_data);
-		free(line);
+	width = xmax - xmin + 1;
+	height = ymax - ymin + 1;
+	if(bytesperline < width) {
+		fprintf(stderr, "Error: PCX image has %u bytes per line for %u pixels\n", bytesperline, width);
 		return NULL;
 	}
 
-	max = width * height;
-	j = 0;
-	for(i = 0; i < max; i++) {
-		data[j++] = palette[(p_data[i])][0];
-		data[j++] = palette[(p_data[i])][1];
-		data[j++] = palette[(p_data[i])][2];
-	}
+	p = buf + sizeof(struct pcx_header);
+	end = buf + size;
 
-	free(p_data);
-	free(line);
-	return data;
-}
-
-static unsigned char *
-load_pcx_data_24(FILE *fp, int width, int height,
-                 unsigned int bytesperline)
-{
-	int i;
-	unsigned char *data;
-	unsigned char *line, *planes[3];
-	unsigned int current_line = 0;
-
-	data = (unsigned char *)malloc(sizeof(unsigned char) * width * height * 3);
-	if(!data)
-		return NULL;
+	/* 8-bit images have a 256 color palette at the end, after a marker byte of 12 */
+	if(planes == 1) {
+		if(size < sizeof(struct pcx_header) + 769 || end[-769] != 12) {
+			fprintf(stderr, "Error: This ain't a palette\n");
+			return NULL;
+		}
+		palette = end - 768;
+		end -= 769;
+	}
 
-	line = (unsigned char *)malloc(sizeof(unsigned char) * bytesperline * 3);
-	if(!line) {
+	data = (unsigned char *)malloc((size_t)width * height * 3);
+	line = (unsigned char *)malloc((size_t)bytesperline * planes);
+	if(!data || !line) {
 		free(data);
+		free(line);
 		return NULL;
 	}
-	planes[0] = line;
-	planes[1] = planes[0] + bytesperline;
-	planes[2] = planes[1] + bytesperline;
 
-	while(current_line < (unsigned int)height) {
-		if(read_scanline(fp, planes, 3, bytesperline) == 0) {
+	out = data;
+	for(y = 0; y < height; y++) {
+		if(!decode_scanline(&p, end, line, bytesperline * planes)) {
+			fprintf(stderr, "Error: PCX image data ends early\n");
 			free(data);
 			free(line);
 			return NULL;
 		}
 
-		for(i = 0; i < width; i++) {
-			data[width * current_line * 3 + i * 3 + 0] = planes[0][i];
-			data[width * current_line * 3 + i * 3 + 1] = planes[1][i];
-			data[width * current_line * 3 + i * 3 + 2] = planes[2][i];
-		}
+		if(planes == 1) {
+			for(x = 0; x < width; x++, out += 3) {
+				const unsigned char *c = palette + line[x] * 3;
 
-		current_line++;
+				out[0] = c[0];
+				out[1] = c[1];
+				out[2] = c[2];
+			}
+		} else {
+			const unsigned char *r = line;
+			const unsigned char *g = line + bytesperline;
+			const unsigned char *b = line + bytesperline * 2;
+
+			for(x = 0; x < width; x++, out += 3) {
+				out[0] = r[x];
+				out[1] = g[x];
+				out[2] = b[x];
+			}
+		}
 	}
 
 	free(line);
+	*widthp = width;
+	*heightp = height;
 	return data;
 }
 
 unsigned char *
 read_pcx(const char *filename, unsigned int *widthp, unsigned int *heightp)
 {
-	FILE *fp;
-	struct pcx_header header;
-	unsigned char *data;
-	int width, height;
-
-	fp = fopen(filename, "rb");
-	if(!fp) {
+	int fd;
+	struct stat st;
+	unsigned char *buf, *data;
+	size_t size;
+	int mapped = 1;
+
+	fd = open(filename, O_RDONLY);
+	if(fd < 0) {
 		fprintf(stderr, "pcx Error: Couldn't open %s for reading\n", filename);
 		return NULL;
 	}
-
-	fread(&header, sizeof(struct pcx_header), 1, fp);
-	header.xmin = le_to_native_short(header.xmin);
-	header.ymin = le_to_native_short(header.ymin);
-	header.xmax = le_to_native_short(header.xmax);
-	header.ymax = le_to_native_short(header.ymax);
-	header.bytesperline = le_to_native_ushort(header.bytesperline);
-
-	if(header.bitsperpixel != 8) {
-		fprintf(stderr, "Error: %s has unsupported number of bits per pixel\n", filename);
-		return NULL;
-	}
-	if(header.colorplanes != 1 && header.colorplanes != 3) {
-		fprintf(stderr, "Error: %s has unsupported number of color planes\n", filename);
+	if(fstat(fd, &st) != 0) {
+		fprintf(stderr, "pcx Error: Couldn't stat %s\n", filename);
+		close(fd);
 		return NULL;
 	}
-
-	width = header.xmax - header.xmin + 1;
-	height = header.ymax - header.ymin + 1;
-
-	if(width < 1 || height < 1) {
-		fprintf(stderr, "Error: %s has bad dimensions (%dx%d)\n", filename, width, height);
-		return NULL;
+	size = st.st_size;
+
+	/* read the whole file at once, mapping it if possible */
+	buf = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if(buf == MAP_FAILED) {
+		mapped = 0;
+		buf = malloc(size ? size : 1);
+		if(!buf || read(fd, buf, size) != (ssize_t)size) {
+			fprintf(stderr, "pcx Error: Couldn't read %s\n", filename);
+			free(buf);
+			close(fd);
+			return NULL;
+		}
 	}
+	close(fd);
 
-	switch(header.colorplanes) {
-		default:
-			data = NULL;
-			break;
-		case 1:
-			data = load_pcx_data_8(fp, width, height, header.bytesperline);
-			break;
-		case 3:
-			data = load_pcx_data_24(fp, width, height, header.bytesperline);
-			break;
-	}
+	data = read_pcx_mem(buf, size, widthp, heightp);
 
-	fclose(fp);
-	*widthp = width;
-	*heightp = height;
+	if(mapped)
+		munmap(buf, size);
+	else
+		free(buf);
 
 	if(!data)
 		fprintf(stderr, "Error: Unable to load %s\n", filename);
@@ -0,0 +1,177 @@
+/*
+ * Copyright (C) 2003 Josh A. Beam
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "pool.h"
+
+static pthread_t threads[MAX_POOL_THREADS];
+static unsigned int thread_ids[MAX_POOL_THREADS];
+static int num_workers = 0;
+static int single_threaded = 0;
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t work_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t done_cond = PTHREAD_COND_INITIALIZER;
+
+/* the current job; protected by lock, except for job_next */
+static pool_func job_func;
+static void *job_arg;
+static unsigned int job_count;
+static volatile unsigned int job_next;
+static unsigned long job_generation = 0;
+static int workers_busy = 0;
+static int quit = 0;
+
+static void
+do_work(unsigned int thread)
+{
+	unsigned int i;
+
+	while((i = __sync_fetch_and_add(&job_next, 1)) < job_count)
+		job_func(job_arg, i, thread);
+}
+
+static void *
+worker(void *arg)
+{
+	unsigned int thread = *(unsigned int *)arg;
+	unsigned long seen = 0;
+
+	pthread_mutex_lock(&lock);
+	for(;;) {
+		while(job_generation == seen && !quit)
+			pthread_cond_wait(&work_cond, &lock);
+		if(quit)
+			break;
+		seen = job_generation;
+
+		pthread_mutex_unlock(&lock);
+		do_work(thread);
+		pthread_mutex_lock(&lock);
+
+		if(--workers_busy == 0)
+			pthread_cond_signal(&done_cond);
+	}
+	pthread_mutex_unlock(&lock);
+
+	return NULL;
+}
+
+int
+pool_init(int num_threads)
+{
+	int i;
+
+	if(num_workers)
+		pool_shutdown();
+
+	if(num_threads <= 0)
+		num_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	if(num_threads < 1)
+		num_threads = 1;
+	if(num_threads > MAX_POOL_THREADS)
+		num_threads = MAX_POOL_THREADS;
+
+	quit = 0;
+	for(i = 0; i < num_threads - 1; i++) {
+		thread_ids[i] = i + 1;
+		if(pthread_create(&threads[i], NULL, worker, &thread_ids[i]) != 0) {
+			fprintf(stderr, "Error: Couldn't create worker thread\n");
+			break;
+		}
+	}
+	num_workers = i;
+
+	return num_workers + 1;
+}
+
+void
+pool_shutdown()
+{
+	int i;
+
+	pthread_mutex_lock(&lock);
+	quit = 1;
+	pthread_cond_broadcast(&work_cond);
+	pthread_mutex_unlock(&lock);
+
+	for(i = 0; i < num_workers; i++)
+		pthread_join(threads[i], NULL);
+	num_workers = 0;
+}
+
+int
+pool_num_threads()
+{
+	return single_threaded ? 1 : num_workers + 1;
+}
+
+void
+pool_set_single_threaded(int single)
+{
+	single_threaded = single;
+}
+
+int
+pool_single_threaded()
+{
+	return single_threaded;
+}
+
+void
+pool_run(pool_func func, void *arg, unsigned int count)
+{
+	unsigned int i;
+
+	if(count == 0)
+		return;
+
+	/* not worth waking the workers for a single item */
+	if(single_threaded || num_workers == 0 || count == 1) {
+		for(i = 0; i < count; i++)
+			func(arg, i, 0);
+		return;
+	}
+
+	pthread_mutex_lock(&lock);
+	job_func = func;
+	job_arg = arg;
+	job_count = count;
+	job_next = 0;
+	workers_busy = num_workers;
+	job_generation++;
+	pthread_cond_broadcast(&work_cond);
+	pthread_mutex_unlock(&lock);
+
+	do_work(0);
+
+	/* wait for the workers so that everything they wrote is visible */
+	pthread_mutex_lock(&lock);
+	while(workers_busy > 0)
+		pthread_cond_wait(&done_cond, &lock);
+	pthread_mutex_unlock(&lock);
+}
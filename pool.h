@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2003 Josh A. Beam
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __POOL_H__
+#define __POOL_H__
+
+/*
+ * A persistent pool of worker threads for splitting loops over
+ * independent items (such as surfaces) across cores.
+ */
+
+#define MAX_POOL_THREADS	64
+
+/* called once for each index; thread is 0 for the calling thread */
+typedef void (*pool_func)(void *arg, unsigned int index, unsigned int thread);
+
+/*
+ * Starts the worker threads. num_threads counts the calling thread, so
+ * 1 starts no workers; 0 uses one thread per online CPU. Returns the
+ * number of threads that will run jobs.
+ */
+int pool_init(int num_threads);
+void pool_shutdown();
+
+int pool_num_threads();
+
+/* forces every job to run on the calling thread, for comparison */
+void pool_set_single_threaded(int single);
+int pool_single_threaded();
+
+/*
+ * Calls func for every index from 0 to count - 1, spread across the
+ * threads, and returns once all calls have finished.
+ */
+void pool_run(pool_func func, void *arg, unsigned int count);
+
+#endif /* __POOL_H__ */
@@ -0,0 +1,201 @@
+/*
+ * Copyright (C) 2003 Josh A. Beam
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "prof.h"
+
+static const char *phase_names[NUM_PROF_PHASES] = {
+	"lightmap", "upload", "geometry", "swap", "frame"
+};
+static const char *counter_names[NUM_PROF_COUNTERS] = {
+	"texels", "upload_bytes", "surfaces_drawn", "shadow_rays",
+	"frustum_culled", "backface_culled", "load_queue",
+	"lightmaps_deferred"
+};
+
+/* the frame in progress */
+static double phase_start[NUM_PROF_PHASES];
+static double phase_time[NUM_PROF_PHASES];
+static unsigned long counters[NUM_PROF_COUNTERS];
+
+/* ring buffer of finished frames */
+static double phase_history[NUM_PROF_PHASES][PROF_HISTORY];
+static double counter_history[NUM_PROF_COUNTERS][PROF_HISTORY];
+static unsigned int history_pos = 0;
+static unsigned int history_len = 0;
+
+struct stats {
+	double min, mean, p50, p95, p99;
+};
+
+double
+prof_time()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (double)ts.tv_sec + (double)ts.tv_nsec / 1000000000.0;
+}
+
+void
+prof_begin(int phase)
+{
+	phase_start[phase] = prof_time();
+}
+
+void
+prof_end(int phase)
+{
+	phase_time[phase] += prof_time() - phase_start[phase];
+}
+
+void
+prof_count(int counter, unsigned long n)
+{
+	counters[counter] += n;
+}
+
+void
+prof_frame_end()
+{
+	static double frame_start = 0.0;
+	double now = prof_time();
+	int i;
+
+	/*
+	 * The frame phase covers everything between two calls, so the
+	 * first call only starts the clock.
+	 */
+	if(frame_start == 0.0) {
+		frame_start = now;
+		for(i = 0; i < NUM_PROF_PHASES; i++)
+			phase_time[i] = 0.0;
+		for(i = 0; i < NUM_PROF_COUNTERS; i++)
+			counters[i] = 0;
+		return;
+	}
+	phase_time[PROF_FRAME] = now - frame_start;
+	frame_start = now;
+
+	for(i = 0; i < NUM_PROF_PHASES; i++) {
+		phase_history[i][history_pos] = phase_time[i];
+		phase_time[i] = 0.0;
+	}
+	for(i = 0; i < NUM_PROF_COUNTERS; i++) {
+		counter_history[i][history_pos] = (double)counters[i];
+		counters[i] = 0;
+	}
+
+	history_pos = (history_pos + 1) % PROF_HISTORY;
+	if(history_len < PROF_HISTORY)
+		history_len++;
+}
+
+static int
+compare_doubles(const void *a, const void *b)
+{
+	double d1 = *(const double *)a, d2 = *(const double *)b;
+
+	return d1 < d2 ? -1 : (d1 > d2 ? 1 : 0);
+}
+
+static void
+get_stats(const double *history, struct stats *st)
+{
+	double sorted[PROF_HISTORY];
+	double sum = 0.0;
+	unsigned int i;
+
+	memset(st, 0, sizeof(struct stats));
+	if(history_len == 0)
+		return;
+
+	/* the history is only in order once it has wrapped, but order doesn't matter here */
+	memcpy(sorted, history, sizeof(double) * history_len);
+	qsort(sorted, history_len, sizeof(double), compare_doubles);
+	for(i = 0; i < history_len; i++)
+		sum += sorted[i];
+
+	st->min = sorted[0];
+	st->mean = sum / history_len;
+	st->p50 = sorted[(history_len - 1) * 50 / 100];
+	st->p95 = sorted[(history_len - 1) * 95 / 100];
+	st->p99 = sorted[(history_len - 1) * 99 / 100];
+}
+
+void
+prof_print()
+{
+	struct stats st;
+	int i;
+
+	printf("Last %u frames:          min      mean       p50       p95       p99\n", history_len);
+	for(i = 0; i < NUM_PROF_PHASES; i++) {
+		get_stats(phase_history[i], &st);
+		printf("  %-14s ms %9.3f %9.3f %9.3f %9.3f %9.3f\n", phase_names[i],
+		       st.min * 1000.0, st.mean * 1000.0, st.p50 * 1000.0,
+		       st.p95 * 1000.0, st.p99 * 1000.0);
+	}
+	for(i = 0; i < NUM_PROF_COUNTERS; i++) {
+		get_stats(counter_history[i], &st);
+		printf("  %-17s %9.0f %9.1f %9.0f %9.0f %9.0f\n", counter_names[i],
+		       st.min, st.mean, st.p50, st.p95, st.p99);
+	}
+}
+
+int
+prof_dump_csv(const char *filename)
+{
+	FILE *fp;
+	struct stats st;
+	int i;
+
+	fp = fopen(filename, "w");
+	if(!fp) {
+		fprintf(stderr, "Error: Couldn't open %s for writing\n", filename);
+		return 0;
+	}
+
+	/* phase times are in milliseconds */
+	fprintf(fp, "name,unit,frames,min,mean,p50,p95,p99\n");
+	for(i = 0; i < NUM_PROF_PHASES; i++) {
+		get_stats(phase_history[i], &st);
+		fprintf(fp, "%s,ms,%u,%.4f,%.4f,%.4f,%.4f,%.4f\n", phase_names[i], history_len,
+		        st.min * 1000.0, st.mean * 1000.0, st.p50 * 1000.0,
+		        st.p95 * 1000.0, st.p99 * 1000.0);
+	}
+	for(i = 0; i < NUM_PROF_COUNTERS; i++) {
+		get_stats(counter_history[i], &st);
+		fprintf(fp, "%s,count,%u,%.0f,%.2f,%.0f,%.0f,%.0f\n", counter_names[i], history_len,
+		        st.min, st.mean, st.p50, st.p95, st.p99);
+	}
+
+	fclose(fp);
+	return 1;
+}
@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2003 Josh A. Beam
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __PROF_H__
+#define __PROF_H__
+
+/*
+ * Per-frame profiling. Time spent in each phase and the counters are
+ * accumulated over a frame and kept for the last PROF_HISTORY frames,
+ * from which min/mean/percentiles are reported.
+ */
+
+#define PROF_HISTORY		1024
+
+/* phases */
+#define PROF_LIGHTMAP		0	/* computing lightmaps */
+#define PROF_UPLOAD		1	/* uploading lightmaps to GL */
+#define PROF_GEOMETRY		2	/* submitting surfaces */
+#define PROF_SWAP		3	/* flush and buffer swap */
+#define PROF_FRAME		4	/* the whole frame */
+#define NUM_PROF_PHASES		5
+
+/* counters */
+#define PROF_TEXELS		0	/* lightmap texels computed */
+#define PROF_UPLOAD_BYTES	1	/* bytes of lightmap data uploaded */
+#define PROF_SURFACES_DRAWN	2
+#define PROF_SHADOW_RAYS	3
+#define PROF_FRUSTUM_CULLED	4	/* surfaces outside the view */
+#define PROF_BACKFACE_CULLED	5	/* surfaces facing away from the camera */
+#define PROF_LOAD_QUEUE		6	/* textures still loading */
+#define PROF_LIGHTMAPS_DEFERRED	7	/* pending lightmaps put off by the time or ray budget */
+#define NUM_PROF_COUNTERS	8
+
+/* seconds from an arbitrary starting point, from CLOCK_MONOTONIC */
+double prof_time();
+
+void prof_begin(int phase);
+void prof_end(int phase);
+void prof_count(int counter, unsigned long n);
+
+/* stores this frame's times and counters in the history and starts a new frame */
+void prof_frame_end();
+
+/* prints the statistics, or writes them to a CSV file; returns 0 on failure */
+void prof_print();
+int prof_dump_csv(const char *filename);
+
+#endif /* __PROF_H__ */
@@ -25,234 +25,615 @@
 
 #include <stdio.h>
 #include <stdlib.h>
-#include <sys/time.h>
+#include <string.h>
+#include <limits.h>
 #include <math.h>
 #include <GL/gl.h>
 #include <GL/glu.h>
-#include <GL/glut.h>
-
-#define LIGHTMAP_SIZE 16
+#include "lightmap.h"
+#include "light.h"
+#include "atlas.h"
+#include "pool.h"
+#include "geometry.h"
+#include "scenefile.h"
+#include "surfpool.h"
+#include "prof.h"
+#include "bake.h"
+#include "shadow.h"
+#include "lightgrid.h"
+#include "frustum.h"
+#include "upload.h"
+#include "shader.h"
+#include "loader.h"
 
 extern unsigned char *read_pcx(const char *filename, unsigned int *widthp, unsigned int *heightp);
 
-struct surface {
-	float vertices[4][3];
-	float matrix[9];
+/*
+ * A surface's lightmap drops a level of detail each time its distance
+ * from the camera, or from the nearest light reaching it, doubles past
+ * these.
+ */
+#define LOD_CAMERA_DISTANCE	8.0f
+#define LOD_LIGHT_DISTANCE	4.0f
+
+/*
+ * With a time, count or shadow ray budget, pending lightmaps that have been
+ * put off this many frames go ahead of all others, oldest first, and are
+ * computed whatever is left of the budget. So is the first pending
+ * lightmap, so at least one is computed each frame and none waits longer
+ * than this even if the budget can't keep up.
+ */
+#define LIGHTMAP_MAX_WAIT	8
+
+static struct scene_data scene;
+static float lightmap_density = LIGHTMAP_DENSITY;
+static int shadows = 0;
+static double lightmap_budget = 0.0;	/* seconds per frame, 0 for no limit */
+static double lightmap_deadline;
+static unsigned int lightmap_limit = 0;	/* lightmaps per frame, 0 for no limit */
+static unsigned int longest_wait = 0;	/* most frames any lightmap has been put off */
+static unsigned int *pending = NULL;	/* this frame's pending lightmaps, most important first */
+static unsigned int *staging_offset = NULL;	/* where each pending lightmap goes in staging */
+static unsigned char *staging = NULL;	/* mapped upload buffer, or NULL to use the atlas pages */
+static int backface_culling = 0;
+static float cam_pos[3];	/* world space camera position for this frame */
+
+/* sets surf's texture coordinates to the part of its rectangle used by the current level */
+static void
+set_lightmap_coords(struct surface *surf)
+{
+	unsigned int width, height;
+	float u0, v0, u1, v1;
+
+	surface_lod_size(surf, surf->lightmap->lod, &width, &height);
+
+	/* keep filtering inside the rectangle by using the outer texel centers as the edges */
+	u0 = ((float)surf->lightmap->x + 0.5f) / (float)ATLAS_PAGE_SIZE;
+	v0 = ((float)surf->lightmap->y + 0.5f) / (float)ATLAS_PAGE_SIZE;
+	u1 = ((float)(surf->lightmap->x + width) - 0.5f) / (float)ATLAS_PAGE_SIZE;
+	v1 = ((float)(surf->lightmap->y + height) - 0.5f) / (float)ATLAS_PAGE_SIZE;
+
+	surf->lightmap_coords[0][0] = u0; surf->lightmap_coords[0][1] = v0;
+	surf->lightmap_coords[1][0] = u0; surf->lightmap_coords[1][1] = v1;
+	surf->lightmap_coords[2][0] = u1; surf->lightmap_coords[2][1] = v1;
+	surf->lightmap_coords[3][0] = u1; surf->lightmap_coords[3][1] = v0;
+}
+
+/*
+ * Finds room in the atlas for surf's lightmap at full detail; lower
+ * levels use the top left part of the same rectangle.
+ */
+static int
+place_lightmap(struct surface *surf)
+{
+	surface_size_lightmap(surf, lightmap_density);
+	surf->lightmap->page = atlas_alloc(surf->lightmap->width, surf->lightmap->height,
+	                                  &surf->lightmap->x, &surf->lightmap->y);
+	if(surf->lightmap->page < 0)
+		return 0;
+
+	surf->lightmap->lod = 0;
+	set_lightmap_coords(surf);
 
-	float s_dist, t_dist;
-};
+	return 1;
+}
 
-static float
-dot_product(float v1[3], float v2[3])
+/* returns how many times dist_sq doubles the distance near */
+static unsigned int
+distance_lod(float dist_sq, float near)
 {
-	return (v1[0] * v2[0] + v1[1] * v2[1] + v1[2] * v2[2]);
+	unsigned int lod = 0;
+
+	near *= near;
+	while(dist_sq > near && lod < LIGHTMAP_MAX_LOD) {
+		near *= 4.0f;
+		lod++;
+	}
+
+	return lod;
 }
 
-static void
-normalize(float v[3])
+/* picks the level of detail for surf from the camera and the lights reaching it, static or not */
+static unsigned int
+choose_lod(const struct surface *surf, const struct light *lights, unsigned int num_lights)
 {
-	float f = 1.0f / sqrt(dot_product(v, v));
+	unsigned int i, lod, light_lod;
+	float d, nearest;
 
-	v[0] *= f;
-	v[1] *= f;
-	v[2] *= f;
+	/* an unlit surface is black at any size */
+	if(num_lights == 0 && !surf->lightmap_base)
+		return LIGHTMAP_MAX_LOD;
+
+	nearest = surf->lightmap_base ? surf->static_dist_sq : surface_distance_sq(surf, lights[0].pos);
+	for(i = 0; i < num_lights; i++) {
+		if((d = surface_distance_sq(surf, lights[i].pos)) < nearest)
+			nearest = d;
+	}
+
+	lod = distance_lod(surface_distance_sq(surf, cam_pos), LOD_CAMERA_DISTANCE);
+	light_lod = distance_lod(nearest, LOD_LIGHT_DISTANCE);
+
+	return lod > light_lod ? lod : light_lod;
 }
 
+/*
+ * Marks a surface's lightmap as pending if the dynamic lights reaching
+ * it or its level of detail have changed. Runs on the worker threads.
+ */
 static void
-cross_product(const float *v1, const float *v2, float *out)
+check_lightmap(void *arg, unsigned int index, unsigned int thread)
 {
-	out[0] = v1[1] * v2[2] - v1[2] * v2[1];
-	out[1] = v1[2] * v2[0] - v1[0] * v2[2];
-	out[2] = v1[0] * v2[1] - v1[1] * v2[0];
+	struct surface_pool *surfs = arg;
+	struct surface *surf = &surfs->records[index];
+	struct light lights[MAX_LIGHTS];
+	unsigned int mask[LIGHT_MASK_WORDS];
+	unsigned int num_lights;
+	float dist_sq, change;
+	int changed;
+
+	/* culled surfaces keep their changes pending until they're seen again */
+	surfs->flags[index] &= ~SURFACE_PENDING;
+	if(surfs->lightmaps[index].page < 0 || (surfs->flags[index] & SURFACE_CULLED))
+		return;
+
+	num_lights = light_gather_dynamic(surf, lights, mask);
+	changed = light_surface_changed(surf, mask, &change);
+	if(changed && change > surfs->changes[index])
+		surfs->changes[index] = change;
+	if(surfs->flags[index] & SURFACE_DIRTY) {
+		surfs->flags[index] &= ~SURFACE_DIRTY;
+		changed = 1;
+	}
+	if(!changed && choose_lod(surf, lights, num_lights) == surfs->lightmaps[index].lod)
+		return;
+
+	/*
+	 * Roughly its area on screen times how far its texels have to move,
+	 * raised the longer it has waited.
+	 */
+	dist_sq = surface_distance_sq(surf, cam_pos);
+	if(dist_sq < 0.01f)
+		dist_sq = 0.01f;
+	surfs->priorities[index] = surfs->extents[index][0] * surfs->extents[index][1] / dist_sq *
+	                           (1.0f + surfs->changes[index]) * (float)(1 + surfs->waits[index]);
+	surfs->flags[index] |= SURFACE_PENDING;
+}
+
+/* orders indexes into the scene's surface pool */
+static int
+compare_priority(const void *a, const void *b)
+{
+	unsigned int i1 = *(const unsigned int *)a, i2 = *(const unsigned int *)b;
+	unsigned int wait1 = scene.pool.waits[i1], wait2 = scene.pool.waits[i2];
+	float priority1 = scene.pool.priorities[i1], priority2 = scene.pool.priorities[i2];
+	int overdue1 = wait1 >= LIGHTMAP_MAX_WAIT;
+	int overdue2 = wait2 >= LIGHTMAP_MAX_WAIT;
+
+	if(overdue1 != overdue2)
+		return overdue1 ? -1 : 1;
+	if(overdue1 && wait1 != wait2)
+		return wait1 > wait2 ? -1 : 1;
+	if(priority1 != priority2)
+		return priority1 > priority2 ? -1 : 1;
+
+	return i1 < i2 ? -1 : (i1 > i2 ? 1 : 0);
 }
 
+/*
+ * Recomputes a pending lightmap, on top of its baked static lighting,
+ * unless the frame's time, count or shadow ray budget has run out and it
+ * isn't overdue (see LIGHTMAP_MAX_WAIT). It's written straight into
+ * the mapped upload buffer if there is one, and into its atlas rectangle
+ * otherwise. This runs on the worker threads, which take surfaces in
+ * order of priority; each surface only writes to its own rectangle.
+ */
 static void
-multiply_vector_by_matrix(const float m[9], float v[3])
+generate_lightmap(void *arg, unsigned int index, unsigned int thread)
 {
-	float tmp[3];
+	unsigned int i = ((unsigned int *)arg)[index];
+	struct surface *surf = &scene.pool.records[i];
+	unsigned char *flags = &scene.pool.flags[i];
+	struct light lights[MAX_LIGHTS];
+	unsigned int num_lights, lod, width, height;
+	struct atlas_page *page;
+	unsigned char *data;
+	unsigned int pitch;
+	int forced = index == 0 || scene.pool.waits[i] >= LIGHTMAP_MAX_WAIT;
+
+	if(!forced && ((lightmap_limit > 0 && index >= lightmap_limit) ||
+	               (lightmap_budget > 0.0 && prof_time() >= lightmap_deadline))) {
+		*flags |= SURFACE_DIRTY;	/* still changed next frame */
+		scene.pool.waits[i]++;
+		return;
+	}
 
-	tmp[0] = v[0] * m[0] + v[1] * m[3] + v[2] * m[6];
-	tmp[1] = v[0] * m[1] + v[1] * m[4] + v[2] * m[7];
-	tmp[2] = v[0] * m[2] + v[1] * m[5] + v[2] * m[8];
+	num_lights = light_gather_dynamic(surf, lights, NULL);
+	lod = choose_lod(surf, lights, num_lights);
+	surface_lod_size(surf, lod, &width, &height);
+	if(staging) {
+		data = staging + staging_offset[index];
+		pitch = width * 3;
+	} else {
+		page = atlas_get_page(surf->lightmap->page);
+		data = page->data + (surf->lightmap->y * ATLAS_PAGE_SIZE + surf->lightmap->x) * 3;
+		pitch = ATLAS_PAGE_SIZE * 3;
+	}
+	if(!shadows) {
+		lightmap_compute(surf, lights, num_lights, data, width, height, pitch);
+	} else if(!shadow_compute(surf, lights, num_lights, data, width, height, pitch, !forced)) {
+		/* out of shadow rays; the last lightmap stays until a later frame */
+		*flags |= SURFACE_DIRTY;
+		scene.pool.waits[i]++;
+		return;
+	}
+	scene.pool.waits[i] = 0;
+	scene.pool.changes[i] = 0.0f;
 
-	v[0] = tmp[0];
-	v[1] = tmp[1];
-	v[2] = tmp[2];
+	if(lod != surf->lightmap->lod) {
+		surf->lightmap->lod = lod;
+		*flags |= SURFACE_RESIZED;
+	}
+	if(surf->lightmap_base)
+		lightmap_add_base(surf, data, width, height, pitch);
+	*flags |= SURFACE_CHANGED;
 }
 
-static struct surface *
-new_surface(float vertices[4][3])
+static int lighting = 1;
+static int shader_lighting = 0;	/* light per pixel in a shader instead of with lightmaps */
+
+void
+scene_toggle_lighting()
 {
-	int i, j;
-	struct surface *surf;
+	lighting = lighting ? 0 : 1;
+}
 
-	surf = malloc(sizeof(struct surface));
-	if(!surf) {
-		fprintf(stderr, "Error: Couldn't allocate memory for surface\n");
-		return NULL;
+void
+scene_toggle_shader()
+{
+	if(!shader_lighting && !shader_init()) {
+		printf("Can't light in a shader, keeping lightmaps\n");
+		return;
 	}
 
-	for(i = 0; i < 4; i++) {
-		for(j = 0; j < 3; j++)
-			surf->vertices[i][j] = vertices[i][j];
-	}
+	shader_lighting = shader_lighting ? 0 : 1;
+	printf("Lighting %s\n", shader_lighting ? "per pixel in a shader" : "from lightmaps");
+}
 
-	/* x axis of matrix points in world space direction of the s texture axis */
-	for(i = 0; i < 3; i++)
-		surf->matrix[0 + i] = surf->vertices[3][i] - surf->vertices[0][i];
-	surf->s_dist = sqrt(dot_product(surf->matrix, surf->matrix));
-	normalize(surf->matrix);
+void
+scene_toggle_geometry()
+{
+	if(geometry_set_mode(geometry_mode() == GEOMETRY_VBO ? GEOMETRY_IMMEDIATE : GEOMETRY_VBO) == GEOMETRY_VBO)
+		printf("Drawing from a vertex buffer object\n");
+	else
+		printf("Drawing in immediate mode\n");
+}
 
-	/* y axis of matrix points in world space direction of the t texture axis */
-	for(i = 0; i < 3; i++)
-		surf->matrix[3 + i] = surf->vertices[1][i] - surf->vertices[0][i];
-	surf->t_dist = sqrt(dot_product(surf->matrix + 3, surf->matrix + 3));
-	normalize(surf->matrix + 3);
+void
+scene_toggle_upload()
+{
+	if(upload_set_mode(upload_mode() == UPLOAD_PBO ? UPLOAD_CLIENT : UPLOAD_PBO) == UPLOAD_PBO)
+		printf("Uploading lightmaps through pixel buffer objects\n");
+	else
+		printf("Uploading lightmaps from client memory\n");
+}
 
-	/* z axis of matrix is the surface's normal */
-	cross_product(surf->matrix, surf->matrix + 3, surf->matrix + 6);
+void
+scene_dump_profile()
+{
+	prof_print();
+	loader_print_stats();
+	if(prof_dump_csv("profile.csv"))
+		printf("Wrote profile.csv\n");
+}
 
-	return surf;
+void
+scene_toggle_threads()
+{
+	pool_set_single_threaded(!pool_single_threaded());
+	printf("Computing lightmaps on %d thread(s)\n", pool_num_threads());
 }
 
-static float light_pos[3] = { 1.0f, 0.0f, 0.25f };
-static float light_color[3] = { 1.0f, 1.0f, 1.0f };
+static float cam_rot[3] = { 0.0f, 0.0f, 0.0f };
+
+static const char *scene_file = "scene.dat";
+static struct surface **surfaces = NULL;
+static unsigned int num_surfaces = 0;
+static unsigned int *textures = NULL;
+static float light_start[MAX_LIGHTS][3];
+static void (*swap_func)() = NULL;
 
-static unsigned int
-generate_lightmap(struct surface *surf)
+/* swap is called at the end of each frame, e.g. glutSwapBuffers */
+void
+scene_set_swap_func(void (*swap)())
 {
-	static unsigned char data[LIGHTMAP_SIZE * LIGHTMAP_SIZE * 3];
-	static unsigned int lightmap_tex_num = 0;
-	unsigned int i, j;
-	float pos[3];
-	float step, s, t;
-
-	if(lightmap_tex_num == 0)
-		glGenTextures(1, &lightmap_tex_num);
-
-	step = 1.0f / (float)LIGHTMAP_SIZE;
-
-	s = t = 0.0f;
-	for(i = 0; i < LIGHTMAP_SIZE; i++) {
-		for(j = 0; j < LIGHTMAP_SIZE; j++) {
-			float d;
-			float tmp;
-
-			pos[0] = surf->s_dist * s;
-			pos[1] = surf->t_dist * t;
-			pos[2] = 0.0f;
-			multiply_vector_by_matrix(surf->matrix, pos);
-
-			pos[0] += surf->vertices[0][0];
-			pos[1] += surf->vertices[0][1];
-			pos[2] += surf->vertices[0][2];
-
-			pos[0] -= light_pos[0];
-			pos[1] -= light_pos[1];
-			pos[2] -= light_pos[2];
-
-			d = dot_product(pos, pos) * 0.5f;
-			if(d < 1.0f)
-				d = 1.0f;
-			tmp = 1.0f / d;
-
-			data[i * LIGHTMAP_SIZE * 3 + j * 3 + 0] = (unsigned char)(255.0f * tmp * light_color[0]);
-			data[i * LIGHTMAP_SIZE * 3 + j * 3 + 1] = (unsigned char)(255.0f * tmp * light_color[1]);
-			data[i * LIGHTMAP_SIZE * 3 + j * 3 + 2] = (unsigned char)(255.0f * tmp * light_color[2]);
-
-			s += step;
-		}
+	swap_func = swap;
+}
+
+void
+scene_set_file(const char *filename)
+{
+	scene_file = filename;
+}
 
-		t += step;
-		s = 0.0f;
+/* limits the time spent computing lightmaps each frame; 0 for no limit */
+void
+scene_set_lightmap_budget(unsigned int usec)
+{
+	lightmap_budget = (double)usec / 1000000.0;
+}
+
+/*
+ * Limits the number of lightmaps computed each frame; 0 for no limit.
+ * Unlike the time budget, this puts off the same lightmaps on every run.
+ */
+void
+scene_set_lightmap_limit(unsigned int count)
+{
+	lightmap_limit = count;
+}
+
+/* returns the most frames any lightmap has been put off for so far */
+unsigned int
+scene_longest_lightmap_wait()
+{
+	return longest_wait;
+}
+
+void
+scene_set_lightmap_density(float density)
+{
+	lightmap_density = density;
+}
+
+void
+scene_toggle_shadows()
+{
+	unsigned int i;
+
+	shadows = shadows ? 0 : 1;
+	for(i = 0; i < num_surfaces; i++)
+		scene.pool.flags[i] |= SURFACE_DIRTY;
+	printf("Shadows %s\n", shadows ? "on" : "off");
+}
+
+/*
+ * Off by default: the demo scene's walls are seen from both sides and
+ * don't all face inwards.
+ */
+void
+scene_toggle_backface_culling()
+{
+	backface_culling = backface_culling ? 0 : 1;
+	printf("Backface culling %s\n", backface_culling ? "on" : "off");
+}
+
+/* when scene_init() started, until the first frame is drawn */
+static double init_time = 0.0;
+
+static void
+scene_init()
+{
+	unsigned int i;
+	const struct light *light;
+	char cache_file[256];
+
+	init_time = prof_time();
+	lightmap_set_kernel(LIGHTMAP_KERNEL_AUTO);
+	pool_init(0);
+
+	if(!scenefile_load(scene_file, &scene))
+		exit(1);
+	surfaces = scene.surfaces;
+	num_surfaces = scene.num_surfaces;
+	pending = malloc(sizeof(unsigned int) * (num_surfaces ? num_surfaces : 1));
+	staging_offset = malloc(sizeof(unsigned int) * (num_surfaces ? num_surfaces : 1));
+	if(!pending || !staging_offset) {
+		fprintf(stderr, "Error: Couldn't allocate memory for surfaces\n");
+		exit(1);
 	}
 
-	glBindTexture(GL_TEXTURE_2D, lightmap_tex_num);
-	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	/* start loading textures; index 0 is left blank if the scene has none */
+	textures = calloc(scene.num_textures ? scene.num_textures : 1, sizeof(unsigned int));
+	if(!textures) {
+		fprintf(stderr, "Error: Couldn't allocate memory for textures\n");
+		exit(1);
+	}
+	glEnable(GL_TEXTURE_2D);
 	glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
-	glTexImage2D(GL_TEXTURE_2D, 0, 3, LIGHTMAP_SIZE, LIGHTMAP_SIZE, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
+	for(i = 0; i < scene.num_textures; i++)
+		textures[i] = loader_load_texture(scene.texture_names[i]);
+
+	/* remember where the moving lights start so scene_interpolate() can orbit them */
+	for(i = 0; i < (unsigned int)light_max_id(); i++) {
+		if((light = light_get(i)) != NULL) {
+			light_start[i][0] = light->pos[0];
+			light_start[i][1] = light->pos[1];
+			light_start[i][2] = light->pos[2];
+		}
+	}
+
+	for(i = 0; i < num_surfaces; i++)
+		place_lightmap(surfaces[i]);
 
-	return lightmap_tex_num;
+	shadow_init(surfaces, num_surfaces);
+	lightgrid_build(surfaces, num_surfaces);
+	lightgrid_update();
+
+	/* static lights are only computed once, or loaded from next to the scene file */
+	sprintf(cache_file, "%.*s.lmc", (int)sizeof(cache_file) - 5, scene_file);
+	bake_static_lights(surfaces, num_surfaces, cache_file);
+
+	geometry_build(surfaces, num_surfaces, textures, scene.pool.flags);
 }
 
-static int lighting = 1;
+static void
+rotate_vector(float v[3], int axis, float degrees)
+{
+	float a = degrees * (float)M_PI / 180.0f;
+	float x = v[(axis + 1) % 3], y = v[(axis + 2) % 3];
 
-void
-scene_toggle_lighting()
+	v[(axis + 1) % 3] = x * cos(a) - y * sin(a);
+	v[(axis + 2) % 3] = x * sin(a) + y * cos(a);
+}
+
+/* undoes the rotations in scene_render() to find the camera in world space */
+static void
+update_camera_position()
 {
-	lighting = lighting ? 0 : 1;
+	cam_pos[0] = 0.0f;
+	cam_pos[1] = 0.0f;
+	cam_pos[2] = 5.0f;
+	rotate_vector(cam_pos, 0, -cam_rot[0]);
+	rotate_vector(cam_pos, 1, -cam_rot[1]);
+	rotate_vector(cam_pos, 2, -cam_rot[2]);
 }
 
-static float cam_rot[3] = { 0.0f, 0.0f, 0.0f };
+/*
+ * Marks the surfaces outside the view, or facing away from the camera
+ * if backface culling is on. Returns how many surfaces are culled. Only
+ * reads the pool's arrays, not the surfaces themselves, and only looks
+ * at the corners of surfaces whose bounding sphere crosses the frustum.
+ */
+static unsigned int
+cull_surfaces()
+{
+	struct frustum frustum;
+	float (*corners)[3], *normal;
+	float projection[16], modelview[16], d;
+	unsigned int i, num_frustum = 0, num_backface = 0;
+	int side;
+
+	/* the same camera transform scene_render() gives GL */
+	memset(modelview, 0, sizeof(modelview));
+	modelview[0] = modelview[5] = modelview[10] = modelview[15] = 1.0f;
+	modelview[14] = -5.0f;
+	matrix_rotate(modelview, cam_rot[0], 0);
+	matrix_rotate(modelview, cam_rot[1], 1);
+	matrix_rotate(modelview, cam_rot[2], 2);
+	glGetFloatv(GL_PROJECTION_MATRIX, projection);
+	frustum_from_matrices(&frustum, projection, modelview);
+
+	update_camera_position();
+
+	for(i = 0; i < num_surfaces; i++) {
+		corners = scene.pool.positions[i];
+		normal = scene.pool.bases[i] + 6;
+		scene.pool.flags[i] &= ~SURFACE_CULLED;
+		side = frustum_test_sphere(&frustum, scene.pool.bounds[i]);
+		if(side == FRUSTUM_OUTSIDE ||
+		   (side == FRUSTUM_INTERSECTS && frustum_cull_quad(&frustum, corners))) {
+			scene.pool.flags[i] |= SURFACE_CULLED;
+			num_frustum++;
+		} else if(backface_culling) {
+			d = normal[0] * (cam_pos[0] - corners[0][0]) +
+			    normal[1] * (cam_pos[1] - corners[0][1]) +
+			    normal[2] * (cam_pos[2] - corners[0][2]);
+			if(d <= 0.0f) {
+				scene.pool.flags[i] |= SURFACE_CULLED;
+				num_backface++;
+			}
+		}
+	}
+
+	prof_count(PROF_FRUSTUM_CULLED, num_frustum);
+	prof_count(PROF_BACKFACE_CULLED, num_backface);
+
+	return num_frustum + num_backface;
+}
+
+/* brings every visible lightmap up to date and uploads the ones that changed */
+static void
+update_lightmaps()
+{
+	struct surface *surf;
+	unsigned int i, width, height, num_pending, num_deferred, size;
+	unsigned char *flags;
+
+	/* compute on the worker threads, then upload from this one once they're all done */
+	prof_begin(PROF_LIGHTMAP);
+	lightmap_deadline = prof_time() + lightmap_budget;
+	lightgrid_update();
+	shadow_begin_frame();
+	pool_run(check_lightmap, &scene.pool, num_surfaces);
+	for(i = num_pending = 0; i < num_surfaces; i++) {
+		if(scene.pool.flags[i] & SURFACE_PENDING)
+			pending[num_pending++] = i;
+	}
+	if(lightmap_budget > 0.0 || lightmap_limit > 0 || shadows)
+		qsort(pending, num_pending, sizeof(unsigned int), compare_priority);
+
+	/* room for each pending lightmap at its full size, whatever level it ends up at */
+	for(i = size = 0; i < num_pending; i++) {
+		surf = surfaces[pending[i]];
+		staging_offset[i] = size;
+		if(size > UINT_MAX - surf->lightmap->width * surf->lightmap->height * 3)
+			break;
+		size += surf->lightmap->width * surf->lightmap->height * 3;
+	}
+	prof_end(PROF_LIGHTMAP);
+	prof_begin(PROF_UPLOAD);
+	staging = i == num_pending ? upload_begin(size) : NULL;
+	prof_end(PROF_UPLOAD);
+	prof_begin(PROF_LIGHTMAP);
+
+	pool_run(generate_lightmap, pending, num_pending);
+	for(i = num_deferred = 0; i < num_pending; i++) {
+		if(scene.pool.waits[pending[i]] > 0)
+			num_deferred++;
+		if(scene.pool.waits[pending[i]] > longest_wait)
+			longest_wait = scene.pool.waits[pending[i]];
+	}
+	prof_count(PROF_LIGHTMAPS_DEFERRED, num_deferred);
+	prof_count(PROF_SHADOW_RAYS, shadow_rays_cast());
+	prof_end(PROF_LIGHTMAP);
+
+	prof_begin(PROF_UPLOAD);
+	for(i = 0; i < num_pending; i++) {
+		surf = surfaces[pending[i]];
+		flags = &scene.pool.flags[pending[i]];
+		if(*flags & SURFACE_RESIZED) {
+			set_lightmap_coords(surf);
+			geometry_update_lightmap_coords(pending[i], surf);
+		}
+		if(*flags & SURFACE_CHANGED) {
+			surface_lod_size(surf, surf->lightmap->lod, &width, &height);
+			if(!staging) {
+				atlas_mark_dirty(surf->lightmap->page, surf->lightmap->x, surf->lightmap->y,
+				                 width, height);
+			} else if(!upload_add(surf->lightmap->page, surf->lightmap->x, surf->lightmap->y,
+			                      width, height, staging_offset[i])) {
+				*flags |= SURFACE_DIRTY;
+			}
+			prof_count(PROF_TEXELS, width * height);
+		}
+		*flags &= ~SURFACE_RESIZED;
+	}
+	if(!upload_lightmaps()) {
+		/* the upload buffer lost what was computed into it */
+		for(i = 0; i < num_pending; i++) {
+			if(scene.pool.flags[pending[i]] & SURFACE_CHANGED)
+				scene.pool.flags[pending[i]] |= SURFACE_DIRTY;
+		}
+	}
+	for(i = 0; i < num_pending; i++)
+		scene.pool.flags[pending[i]] &= ~SURFACE_CHANGED;
+	staging = NULL;
+	prof_end(PROF_UPLOAD);
+}
 
 void
 scene_render()
 {
-	static struct surface *surfaces[6] = {NULL,NULL,NULL,NULL,NULL,NULL};
-	static unsigned int surface_tex_num;
 	int i;
+	unsigned int num_culled;
+	const struct light *light;
 
-	if(!surfaces[0]) {
-		unsigned char *data;
-		unsigned int width, height;
-		float v[4][3];
+	if(!surfaces)
+		scene_init();
 
-		glEnable(GL_TEXTURE_2D);
-
-		/* load texture */
-		data = read_pcx("texture.pcx", &width, &height);
-		glEnable(GL_TEXTURE_2D);
-		glGenTextures(1, &surface_tex_num);
-		glBindTexture(GL_TEXTURE_2D, surface_tex_num);
-		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
-		glTexImage2D(GL_TEXTURE_2D, 0, 3, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-
-		/* create surfaces */
-		v[0][0] = -1.0f; v[0][1] = 1.0f; v[0][2] = 3.0f;
-		v[1][0] = -1.0f; v[1][1] = 1.0f; v[1][2] = 1.0f;
-		v[2][0] = 1.0f; v[2][1] = 1.0f; v[2][2] = 1.0f;
-		v[3][0] = 1.0f; v[3][1] = 1.0f; v[3][2] = 3.0f;
-		surfaces[0] = new_surface(v);
-
-		v[0][0] = 1.0f; v[0][1] = 1.0f; v[0][2] = -1.0f;
-		v[1][0] = 1.0f; v[1][1] = -1.0f; v[1][2] = -1.0f;
-		v[2][0] = -1.0f; v[2][1] = -1.0f; v[2][2] = -1.0f;
-		v[3][0] = -1.0f; v[3][1] = 1.0f; v[3][2] = -1.0f;
-		surfaces[1] = new_surface(v);
-
-		v[0][0] = -1.0f; v[0][1] = 1.0f; v[0][2] = 1.0f;
-		v[1][0] = -1.0f; v[1][1] = 1.0f; v[1][2] = -1.0f;
-		v[2][0] = 1.0f; v[2][1] = 1.0f; v[2][2] = -1.0f;
-		v[3][0] = 1.0f; v[3][1] = 1.0f; v[3][2] = 1.0f;
-		surfaces[2] = new_surface(v);
-
-		v[0][0] = 1.0f; v[0][1] = -1.0f; v[0][2] = 1.0f;
-		v[1][0] = 1.0f; v[1][1] = -1.0f; v[1][2] = -1.0f;
-		v[2][0] = -1.0f; v[2][1] = -1.0f; v[2][2] = -1.0f;
-		v[3][0] = -1.0f; v[3][1] = -1.0f; v[3][2] = 1.0f;
-		surfaces[3] = new_surface(v);
-
-		v[0][0] = -1.0f; v[0][1] = 1.0f; v[0][2] = 1.0f;
-		v[1][0] = -1.0f; v[1][1] = 1.0f; v[1][2] = -1.0f;
-		v[2][0] = -1.0f; v[2][1] = -1.0f; v[2][2] = -1.0f;
-		v[3][0] = -1.0f; v[3][1] = -1.0f; v[3][2] = 1.0f;
-		surfaces[4] = new_surface(v);
-
-		v[0][0] = 1.0f; v[0][1] = -1.0f; v[0][2] = 1.0f;
-		v[1][0] = 1.0f; v[1][1] = -1.0f; v[1][2] = -1.0f;
-		v[2][0] = 1.0f; v[2][1] = 1.0f; v[2][2] = -1.0f;
-		v[3][0] = 1.0f; v[3][1] = 1.0f; v[3][2] = 1.0f;
-		surfaces[5] = new_surface(v);
-	}
+	/* swap in any textures that have finished loading */
+	loader_poll();
+	prof_count(PROF_LOAD_QUEUE, loader_pending());
 
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 	glLoadIdentity();
@@ -260,85 +641,190 @@ scene_render()
 	glRotatef(cam_rot[0], 1.0f, 0.0f, 0.0f);
 	glRotatef(cam_rot[1], 0.0f, 1.0f, 0.0f);
 	glRotatef(cam_rot[2], 0.0f, 0.0f, 1.0f);
+	num_culled = cull_surfaces();
 
 	glActiveTextureARB(GL_TEXTURE0_ARB);
 	glEnable(GL_TEXTURE_2D);
-	glBindTexture(GL_TEXTURE_2D, surface_tex_num);
 	glActiveTextureARB(GL_TEXTURE1_ARB);
-	if(lighting)
+	glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+	if(lighting && !shader_lighting) {
 		glEnable(GL_TEXTURE_2D);
+		update_lightmaps();
+	}
 
-	for(i = 0; i < 6; i++) {
-		if(!surfaces[i])
-			break;
-
-		if(lighting)
-			glBindTexture(GL_TEXTURE_2D, generate_lightmap(surfaces[i]));
-		glBegin(GL_QUADS);
-			glMultiTexCoord2fARB(GL_TEXTURE0_ARB, 0.0f, 0.0f);
-			glMultiTexCoord2fARB(GL_TEXTURE1_ARB, 0.0f, 0.0f);
-			glVertex3fv(surfaces[i]->vertices[0]);
-			glMultiTexCoord2fARB(GL_TEXTURE0_ARB, 0.0f, 1.0f);
-			glMultiTexCoord2fARB(GL_TEXTURE1_ARB, 0.0f, 1.0f);
-			glVertex3fv(surfaces[i]->vertices[1]);
-			glMultiTexCoord2fARB(GL_TEXTURE0_ARB, 1.0f, 1.0f);
-			glMultiTexCoord2fARB(GL_TEXTURE1_ARB, 1.0f, 1.0f);
-			glVertex3fv(surfaces[i]->vertices[2]);
-			glMultiTexCoord2fARB(GL_TEXTURE0_ARB, 1.0f, 0.0f);
-			glMultiTexCoord2fARB(GL_TEXTURE1_ARB, 1.0f, 0.0f);
-			glVertex3fv(surfaces[i]->vertices[3]);
-		glEnd();
+	prof_begin(PROF_GEOMETRY);
+	if(lighting && shader_lighting) {
+		shader_begin();
+		geometry_draw(0);
+		shader_end();
+	} else {
+		geometry_draw(lighting);
 	}
+	prof_count(PROF_SURFACES_DRAWN, num_surfaces - num_culled);
+	prof_end(PROF_GEOMETRY);
 
-	/* render light */
+	/* render lights */
+	glActiveTextureARB(GL_TEXTURE1_ARB);
 	glDisable(GL_TEXTURE_2D);
 	glActiveTextureARB(GL_TEXTURE0_ARB);
 	glDisable(GL_TEXTURE_2D);
-	glColor3fv(light_color);
-	glBegin(GL_QUADS);
-		glVertex3f(light_pos[0] - 0.05f, light_pos[1] + 0.05f, light_pos[2] + 0.05f);
-		glVertex3f(light_pos[0] - 0.05f, light_pos[1] - 0.05f, light_pos[2] + 0.05f);
-		glVertex3f(light_pos[0] + 0.05f, light_pos[1] - 0.05f, light_pos[2] + 0.05f);
-		glVertex3f(light_pos[0] + 0.05f, light_pos[1] + 0.05f, light_pos[2] + 0.05f);
-	glEnd();
+	for(i = 0; i < light_max_id(); i++) {
+		if(!(light = light_get(i)))
+			continue;
+
+		glColor3fv(light->color);
+		glBegin(GL_QUADS);
+			glVertex3f(light->pos[0] - 0.05f, light->pos[1] + 0.05f, light->pos[2] + 0.05f);
+			glVertex3f(light->pos[0] - 0.05f, light->pos[1] - 0.05f, light->pos[2] + 0.05f);
+			glVertex3f(light->pos[0] + 0.05f, light->pos[1] - 0.05f, light->pos[2] + 0.05f);
+			glVertex3f(light->pos[0] + 0.05f, light->pos[1] + 0.05f, light->pos[2] + 0.05f);
+		glEnd();
+	}
 	glColor4f(1.0f, 1.0f, 1.0f, 1.0f);
 
+	prof_begin(PROF_SWAP);
 	glFlush();
-	glutSwapBuffers();
+	if(swap_func)
+		swap_func();
+	prof_end(PROF_SWAP);
+
+	prof_frame_end();
+
+	if(init_time > 0.0) {
+		printf("First frame drawn %.1f ms after loading started, %u texture(s) still loading\n",
+		       (prof_time() - init_time) * 1000.0, loader_pending());
+		init_time = 0.0;
+	}
 }
 
-static unsigned int
-get_ticks()
+/* loads the scene now if it hasn't been, and waits for all of its textures */
+void
+scene_finish_loading()
 {
-	struct timeval t;
+	if(!surfaces)
+		scene_init();
+	loader_wait();
+}
 
-	gettimeofday(&t, NULL);
+/*
+ * Measures the CPU cost of submitting count small surfaces in immediate
+ * mode and from a vertex buffer object, averaged over frames frames.
+ */
+void
+scene_bench_draw(unsigned int count, unsigned int frames)
+{
+	struct surface_pool grid_pool;
+	struct surface **grid;
+	unsigned int side, i, f;
+	float size, v[4][3];
+	double start, submit, total;
+	int mode;
+
+	if(!surfaces)
+		scene_init();
+
+	grid = malloc(sizeof(struct surface *) * count);
+	if(!grid || !surfpool_init(&grid_pool, count) ||
+	   surfpool_alloc(&grid_pool, count, NULL) < 0) {
+		fprintf(stderr, "Error: Couldn't allocate memory for surfaces\n");
+		exit(1);
+	}
+
+	/* cover the back wall with a grid of small surfaces */
+	for(side = 1; side * side < count; side++);
+	size = 2.0f / (float)side;
+	for(i = 0; i < count; i++) {
+		v[0][0] = -1.0f + (float)(i % side) * size;
+		v[0][1] = -1.0f + (float)(i / side) * size;
+		v[0][2] = v[1][2] = v[2][2] = v[3][2] = -1.0f;
+		v[1][0] = v[0][0]; v[1][1] = v[0][1] + size;
+		v[2][0] = v[0][0] + size; v[2][1] = v[1][1];
+		v[3][0] = v[2][0]; v[3][1] = v[0][1];
+		grid[i] = &grid_pool.records[i];
+		surface_init(grid[i], v);
+	}
+	geometry_build(grid, count, textures, grid_pool.flags);
+
+	glLoadIdentity();
+	glTranslatef(0.0f, 0.0f, -5.0f);
+	glActiveTextureARB(GL_TEXTURE0_ARB);
+	glEnable(GL_TEXTURE_2D);
+
+	printf("Drawing %u surfaces, %u frames\n", count, frames);
+	for(mode = GEOMETRY_IMMEDIATE; mode <= GEOMETRY_VBO; mode++) {
+		if(geometry_set_mode(mode) != mode)
+			continue;
+
+		/* the first frame includes any one-time setup in the driver */
+		geometry_draw(0);
+		glFinish();
+
+		submit = total = 0.0;
+		for(f = 0; f < frames; f++) {
+			start = prof_time();
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			geometry_draw(0);
+			submit += prof_time() - start;
+			glFinish();
+			total += prof_time() - start;
+		}
+
+		printf("  %s: %.3f ms submission, %.3f ms total per frame\n",
+		       mode == GEOMETRY_VBO ? "vertex buffer" : "immediate",
+		       submit * 1000.0 / frames, total * 1000.0 / frames);
+	}
 
-	return (t.tv_sec * 1000) + (t.tv_usec / 1000);
+	surfpool_free(&grid_pool);
+	free(grid);
+	geometry_build(surfaces, num_surfaces, textures, scene.pool.flags);
 }
 
+/*
+ * The camera's roll and the angle of the orbiting lights after the last
+ * two updates; frames are drawn between them.
+ */
+static float anim_cam[2] = { 0.0f, 0.0f };
+static float anim_light[2] = { 0.0f, 0.0f };
+
 void
-scene_cycle()
+scene_update(float seconds)
 {
-	static float light_rot = 0.0f;
-	static unsigned int prev_ticks = 0;
-	unsigned int ticks;
-	float time;
+	anim_cam[0] = anim_cam[1];
+	anim_light[0] = anim_light[1];
 
-	if(!prev_ticks)
-		prev_ticks = get_ticks();
+	anim_cam[1] -= 10.0f * seconds;
+	anim_light[1] += seconds;
 
-	ticks = get_ticks();
-	time = (float)(ticks - prev_ticks);
-	prev_ticks = ticks;
+	/* wrap both so interpolating between them doesn't go the long way around */
+	if(anim_cam[1] < 0.0f) {
+		anim_cam[0] += 360.0f;
+		anim_cam[1] += 360.0f;
+	}
+	if(anim_light[1] > 2.0f * (float)M_PI) {
+		anim_light[0] -= 2.0f * (float)M_PI;
+		anim_light[1] -= 2.0f * (float)M_PI;
+	}
+}
 
-	cam_rot[2] -= 0.01f * time;
-	while(cam_rot[2] < 0.0f)
-		cam_rot[2] += 360.0f;
+/* puts the camera and lights alpha of the way from the second last update to the last */
+void
+scene_interpolate(float alpha)
+{
+	float light_rot, pos[3];
+	int i;
+	const struct light *light;
 
-	light_pos[0] = cos(light_rot) * 0.8f;
-	light_pos[1] = sin(light_rot) * 0.8f;
-	light_rot += 0.001f * time;
+	cam_rot[2] = anim_cam[0] + (anim_cam[1] - anim_cam[0]) * alpha;
+	light_rot = anim_light[0] + (anim_light[1] - anim_light[0]) * alpha;
 
-	scene_render();
+	/* lights that aren't static circle around the z axis */
+	for(i = 0; i < light_max_id(); i++) {
+		if(!(light = light_get(i)) || (light->flags & LIGHT_STATIC))
+			continue;
+
+		pos[0] = light_start[i][0] * cos(light_rot) - light_start[i][1] * sin(light_rot);
+		pos[1] = light_start[i][0] * sin(light_rot) + light_start[i][1] * cos(light_rot);
+		pos[2] = light_start[i][2];
+		light_move(i, pos);
+	}
 }
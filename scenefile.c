@@ -0,0 +1,164 @@
+/*
+ * Copyright (C) 2003 Josh A. Beam
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "scenefile.h"
+#include "light.h"
+
+/* checks that count records of the given size starting at offset are inside the file */
+static int
+check_range(size_t file_size, uint32_t offset, uint32_t count, size_t record_size)
+{
+	if(offset % 4 != 0 || offset > file_size)
+		return 0;
+
+	return (count <= (file_size - offset) / record_size);
+}
+
+static void
+read_floats(float *out, const float *in, int n)
+{
+	memcpy(out, in, sizeof(float) * n);
+	le_to_native_float_array(out, n);
+}
+
+int
+scenefile_load(const char *filename, struct scene_data *scene)
+{
+	int fd;
+	struct stat st;
+	const unsigned char *map;
+	const struct scenefile_header *header;
+	const struct scenefile_texture *textures;
+	const struct scenefile_surface *surfaces;
+	const struct scenefile_light *lights;
+	unsigned int i, num_textures, num_surfaces, num_lights;
+	size_t size;
+
+	memset(scene, 0, sizeof(struct scene_data));
+
+	fd = open(filename, O_RDONLY);
+	if(fd < 0) {
+		fprintf(stderr, "Error: Couldn't open %s for reading\n", filename);
+		return 0;
+	}
+	if(fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(struct scenefile_header)) {
+		fprintf(stderr, "Error: %s is too small to be a scene file\n", filename);
+		close(fd);
+		return 0;
+	}
+	size = st.st_size;
+
+	map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(map == MAP_FAILED) {
+		fprintf(stderr, "Error: Couldn't map %s\n", filename);
+		return 0;
+	}
+
+	header = (const struct scenefile_header *)map;
+	num_textures = le_to_native_uint(header->num_textures);
+	num_surfaces = le_to_native_uint(header->num_surfaces);
+	num_lights = le_to_native_uint(header->num_lights);
+
+	if(memcmp(header->magic, SCENEFILE_MAGIC, 4) != 0 ||
+	   le_to_native_uint(header->version) != SCENEFILE_VERSION) {
+		fprintf(stderr, "Error: %s isn't a version %d scene file\n", filename, SCENEFILE_VERSION);
+		munmap((void *)map, size);
+		return 0;
+	}
+	if(!check_range(size, le_to_native_uint(header->textures_offset), num_textures, sizeof(struct scenefile_texture)) ||
+	   !check_range(size, le_to_native_uint(header->surfaces_offset), num_surfaces, sizeof(struct scenefile_surface)) ||
+	   !check_range(size, le_to_native_uint(header->lights_offset), num_lights, sizeof(struct scenefile_light))) {
+		fprintf(stderr, "Error: %s is truncated or corrupt\n", filename);
+		munmap((void *)map, size);
+		return 0;
+	}
+
+	textures = (const struct scenefile_texture *)(map + le_to_native_uint(header->textures_offset));
+	surfaces = (const struct scenefile_surface *)(map + le_to_native_uint(header->surfaces_offset));
+	lights = (const struct scenefile_light *)(map + le_to_native_uint(header->lights_offset));
+
+	scene->texture_names = malloc(SCENEFILE_NAME_LEN * (num_textures ? num_textures : 1));
+	scene->surfaces = malloc(sizeof(struct surface *) * (num_surfaces ? num_surfaces : 1));
+	if(!scene->texture_names || !scene->surfaces ||
+	   !surfpool_init(&scene->pool, num_surfaces) ||
+	   surfpool_alloc(&scene->pool, num_surfaces, NULL) < 0) {
+		fprintf(stderr, "Error: Couldn't allocate memory for scene\n");
+		munmap((void *)map, size);
+		scenefile_free(scene);
+		return 0;
+	}
+
+	scene->num_textures = num_textures;
+	for(i = 0; i < num_textures; i++) {
+		memcpy(scene->texture_names[i], textures[i].name, SCENEFILE_NAME_LEN);
+		scene->texture_names[i][SCENEFILE_NAME_LEN - 1] = '\0';
+	}
+
+	scene->num_surfaces = num_surfaces;
+	for(i = 0; i < num_surfaces; i++) {
+		struct surface *surf = &scene->pool.records[i];
+
+		read_floats(surf->vertices[0], surfaces[i].vertices[0], 12);
+		read_floats(surf->matrix, surfaces[i].matrix, 9);
+		surf->extents[0] = le_to_native_float(surfaces[i].s_dist);
+		surf->extents[1] = le_to_native_float(surfaces[i].t_dist);
+		surf->texture = le_to_native_uint(surfaces[i].texture);
+		if(surf->texture >= (int)num_textures || surf->texture < 0)
+			surf->texture = 0;
+		surface_reset(surf);
+
+		scene->surfaces[i] = surf;
+	}
+	scene->pool.append_only = 1;
+
+	for(i = 0; i < num_lights; i++) {
+		float pos[3], color[3];
+
+		read_floats(pos, lights[i].pos, 3);
+		read_floats(color, lights[i].color, 3);
+		light_add(pos, color, le_to_native_float(lights[i].radius),
+		          le_to_native_uint(lights[i].flags));
+	}
+
+	munmap((void *)map, size);
+	return 1;
+}
+
+void
+scenefile_free(struct scene_data *scene)
+{
+	free(scene->texture_names);
+	surfpool_free(&scene->pool);
+	free(scene->surfaces);
+	memset(scene, 0, sizeof(struct scene_data));
+}
@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2003 Josh A. Beam
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __SCENEFILE_H__
+#define __SCENEFILE_H__
+
+#include <stdint.h>
+#include "my_endian.h"
+#include "lightmap.h"
+#include "surfpool.h"
+
+/*
+ * Binary scene files are written by mkscene from a text description and
+ * loaded with scenefile_load(). Everything is little-endian and every
+ * record is a multiple of four bytes, so the file can be mapped and read
+ * in place. Surfaces are stored with their matrix and extents already
+ * computed.
+ */
+
+#define SCENEFILE_MAGIC		"DLMS"
+#define SCENEFILE_VERSION	1
+#define SCENEFILE_NAME_LEN	64
+
+struct scenefile_header {
+	char magic[4];
+	uint32_t version;
+	uint32_t num_textures;
+	uint32_t num_surfaces;
+	uint32_t num_lights;
+	uint32_t textures_offset;	/* byte offsets from the start of the file */
+	uint32_t surfaces_offset;
+	uint32_t lights_offset;
+};
+
+struct scenefile_texture {
+	char name[SCENEFILE_NAME_LEN];	/* nul-terminated */
+};
+
+struct scenefile_surface {
+	float vertices[4][3];
+	float matrix[9];
+	float s_dist, t_dist;
+	uint32_t texture;
+};
+
+struct scenefile_light {
+	float pos[3];
+	float color[3];
+	float radius;
+	uint32_t flags;
+};
+
+/*
+ * The records are written and read with fwrite()/fread(), so their sizes
+ * are part of the file format. These fail to compile if a compiler pads
+ * them or a type isn't the width the format expects.
+ */
+typedef char scenefile_header_size_check[sizeof(struct scenefile_header) == 32 ? 1 : -1];
+typedef char scenefile_texture_size_check[sizeof(struct scenefile_texture) == SCENEFILE_NAME_LEN ? 1 : -1];
+typedef char scenefile_surface_size_check[sizeof(struct scenefile_surface) == 96 ? 1 : -1];
+typedef char scenefile_light_size_check[sizeof(struct scenefile_light) == 32 ? 1 : -1];
+
+struct scene_data {
+	unsigned int num_textures;
+	char (*texture_names)[SCENEFILE_NAME_LEN];
+
+	/*
+	 * all surfaces are in an append-only pool, with an array of pointers
+	 * to its records
+	 */
+	unsigned int num_surfaces;
+	struct surface_pool pool;
+	struct surface **surfaces;
+};
+
+/*
+ * Loads a scene file, adding its lights with light_add(). Returns 0 if
+ * the file couldn't be read or is invalid.
+ */
+int scenefile_load(const char *filename, struct scene_data *scene);
+void scenefile_free(struct scene_data *scene);
+
+#endif /* __SCENEFILE_H__ */
@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2003 Josh A. Beam
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <time.h>
+#include "sched.h"
+#include "prof.h"
+
+#define UPDATE_STEP	(1.0 / (double)SCHED_UPDATE_RATE)
+
+static void (*update_func)(float seconds) = NULL;
+static double frame_step = 1.0 / (double)SCHED_DEFAULT_FPS;
+static int simulate_only = 0;
+
+static double next_update = 0.0;	/* time the next update is due */
+static double next_frame = 0.0;
+static float alpha = 0.0f;
+
+void
+sched_init(void (*update)(float seconds))
+{
+	update_func = update;
+	next_update = next_frame = prof_time();
+}
+
+void
+sched_set_frame_cap(float fps)
+{
+	frame_step = fps > 0.0f ? 1.0 / (double)fps : 0.0;
+}
+
+void
+sched_set_simulate_only(int enabled)
+{
+	simulate_only = enabled;
+}
+
+static void
+sleep_until(double t)
+{
+	struct timespec ts;
+	double delay = t - prof_time();
+
+	if(delay <= 0.0)
+		return;
+
+	ts.tv_sec = (time_t)delay;
+	ts.tv_nsec = (long)((delay - (double)ts.tv_sec) * 1000000000.0);
+	nanosleep(&ts, NULL);
+}
+
+int
+sched_idle()
+{
+	double now = prof_time();
+	int updates = 0;
+
+	while(now >= next_update) {
+		/* fell too far behind; skip ahead rather than never catching up */
+		if(updates == SCHED_MAX_UPDATES) {
+			next_update = now + UPDATE_STEP;
+			break;
+		}
+
+		if(update_func)
+			update_func((float)UPDATE_STEP);
+		next_update += UPDATE_STEP;
+		updates++;
+	}
+
+	/* the last update is at next_update - UPDATE_STEP */
+	alpha = (float)(1.0 - (next_update - now) / UPDATE_STEP);
+	if(alpha < 0.0f)
+		alpha = 0.0f;
+
+	if(simulate_only) {
+		sleep_until(next_update);
+		return 0;
+	}
+
+	if(now < next_frame) {
+		sleep_until(next_update < next_frame ? next_update : next_frame);
+		return 0;
+	}
+
+	next_frame += frame_step;
+	if(next_frame < now)
+		next_frame = now + frame_step;
+
+	return 1;
+}
+
+float
+sched_alpha()
+{
+	return alpha;
+}
@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2003 Josh A. Beam
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __SCHED_H__
+#define __SCHED_H__
+
+/*
+ * Runs the simulation in fixed steps of 1 / SCHED_UPDATE_RATE seconds,
+ * however often frames are drawn, and tells the caller when to draw one.
+ * Frames are drawn between two updates, so the renderer is given how far
+ * between them the current time is. Between frames and updates the
+ * process sleeps instead of spinning.
+ */
+
+#define SCHED_UPDATE_RATE	100
+#define SCHED_MAX_UPDATES	10	/* per call; any more simulation time is dropped */
+#define SCHED_DEFAULT_FPS	60
+
+/* update advances the simulation by the given number of seconds */
+void sched_init(void (*update)(float seconds));
+
+/* limits frames per second; 0 draws as often as possible */
+void sched_set_frame_cap(float fps);
+
+/* only updates, never asking for a frame */
+void sched_set_simulate_only(int enabled);
+
+/*
+ * Runs any updates that are due and returns 1 if a frame should be drawn
+ * now. Sleeps until the next update or frame if there is nothing to do.
+ */
+int sched_idle();
+
+/* how far between the last two updates the current time is, from 0 to 1 */
+float sched_alpha();
+
+#endif /* __SCHED_H__ */
@@ -0,0 +1,198 @@
+/*
+ * Copyright (C) 2003 Josh A. Beam
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define GL_GLEXT_PROTOTYPES
+
+#include <stdio.h>
+#include <GL/gl.h>
+#include <GL/glext.h>
+#include "shader.h"
+#include "lightmap.h"
+#include "light.h"
+
+extern int have_extension(const char *name);
+
+/* MAX_LIGHTS as a string for the shader source */
+#define STRINGIFY(x)		#x
+#define TO_STRING(x)		STRINGIFY(x)
+#define MAX_LIGHTS_STRING	TO_STRING(MAX_LIGHTS)
+
+static const char *vertex_source[] = {
+	"varying vec3 world_pos;\n",
+	"\n",
+	"void main()\n",
+	"{\n",
+	"	world_pos = gl_Vertex.xyz;\n",
+	"	gl_TexCoord[0] = gl_MultiTexCoord0;\n",
+	"	gl_Position = ftransform();\n",
+	"}\n",
+};
+
+/* a light's w is the square of its cull radius, so it stops where a lightmap would */
+static const char *fragment_source[] = {
+	"#define MAX_LIGHTS " MAX_LIGHTS_STRING "\n",
+	"uniform sampler2D surface_texture;\n",
+	"uniform int num_lights;\n",
+	"uniform vec4 light_pos[MAX_LIGHTS];\n",
+	"uniform vec3 light_color[MAX_LIGHTS];\n",
+	"varying vec3 world_pos;\n",
+	"\n",
+	"void main()\n",
+	"{\n",
+	"	vec3 sum = vec3(0.0);\n",
+	"	vec3 delta;\n",
+	"	float d;\n",
+	"	int i;\n",
+	"\n",
+	"	for(i = 0; i < MAX_LIGHTS; i++) {\n",
+	"		if(i >= num_lights)\n",
+	"			break;\n",
+	"		delta = world_pos - light_pos[i].xyz;\n",
+	"		d = dot(delta, delta);\n",
+	"		if(d < light_pos[i].w)\n",
+	"			sum += light_color[i] / max(1.0, d * 0.5);\n",
+	"	}\n",
+	"\n",
+	"	gl_FragColor = texture2D(surface_texture, gl_TexCoord[0].st) * vec4(min(sum, 1.0), 1.0);\n",
+	"}\n",
+};
+
+static GLhandleARB program = 0;
+static GLint loc_num_lights, loc_light_pos, loc_light_color;
+
+static GLhandleARB
+compile(GLenum type, const char **lines, int num_lines)
+{
+	GLhandleARB shader;
+	char log[1024];
+	GLint status;
+
+	shader = glCreateShaderObjectARB(type);
+	glShaderSourceARB(shader, num_lines, lines, NULL);
+	glCompileShaderARB(shader);
+	glGetObjectParameterivARB(shader, GL_OBJECT_COMPILE_STATUS_ARB, &status);
+	if(!status) {
+		glGetInfoLogARB(shader, sizeof(log), NULL, log);
+		fprintf(stderr, "Error: Couldn't compile shader:\n%s\n", log);
+		glDeleteObjectARB(shader);
+		return 0;
+	}
+
+	return shader;
+}
+
+int
+shader_init()
+{
+	GLhandleARB vs, fs;
+	char log[1024];
+	GLint status;
+
+	if(program)
+		return 1;
+
+	if(!have_extension("GL_ARB_shader_objects") ||
+	   !have_extension("GL_ARB_vertex_shader") ||
+	   !have_extension("GL_ARB_fragment_shader")) {
+		fprintf(stderr, "GLSL isn't supported\n");
+		return 0;
+	}
+
+	vs = compile(GL_VERTEX_SHADER_ARB, vertex_source,
+	             sizeof(vertex_source) / sizeof(vertex_source[0]));
+	fs = compile(GL_FRAGMENT_SHADER_ARB, fragment_source,
+	             sizeof(fragment_source) / sizeof(fragment_source[0]));
+	if(!vs || !fs) {
+		if(vs)
+			glDeleteObjectARB(vs);
+		if(fs)
+			glDeleteObjectARB(fs);
+		return 0;
+	}
+
+	program = glCreateProgramObjectARB();
+	glAttachObjectARB(program, vs);
+	glAttachObjectARB(program, fs);
+	glLinkProgramARB(program);
+
+	/* the program keeps them until it's deleted */
+	glDeleteObjectARB(vs);
+	glDeleteObjectARB(fs);
+
+	glGetObjectParameterivARB(program, GL_OBJECT_LINK_STATUS_ARB, &status);
+	if(!status) {
+		glGetInfoLogARB(program, sizeof(log), NULL, log);
+		fprintf(stderr, "Error: Couldn't link shader program:\n%s\n", log);
+		glDeleteObjectARB(program);
+		program = 0;
+		return 0;
+	}
+
+	glUseProgramObjectARB(program);
+	glUniform1iARB(glGetUniformLocationARB(program, "surface_texture"), 0);
+	loc_num_lights = glGetUniformLocationARB(program, "num_lights");
+	loc_light_pos = glGetUniformLocationARB(program, "light_pos");
+	loc_light_color = glGetUniformLocationARB(program, "light_color");
+	glUseProgramObjectARB(0);
+
+	return 1;
+}
+
+void
+shader_begin()
+{
+	float pos[MAX_LIGHTS][4], color[MAX_LIGHTS][3];
+	const struct light *light;
+	float r;
+	int i, n = 0;
+
+	for(i = 0; i < light_max_id(); i++) {
+		if(!(light = light_get(i)))
+			continue;
+
+		r = light_cull_radius(light);
+		pos[n][0] = light->pos[0];
+		pos[n][1] = light->pos[1];
+		pos[n][2] = light->pos[2];
+		pos[n][3] = r * r;
+		color[n][0] = light->color[0];
+		color[n][1] = light->color[1];
+		color[n][2] = light->color[2];
+		n++;
+	}
+
+	glUseProgramObjectARB(program);
+	glUniform1iARB(loc_num_lights, n);
+	if(n > 0) {
+		glUniform4fvARB(loc_light_pos, n, pos[0]);
+		glUniform3fvARB(loc_light_color, n, color[0]);
+	}
+}
+
+void
+shader_end()
+{
+	glUseProgramObjectARB(0);
+}
@@ -0,0 +1,461 @@
+/*
+ * Copyright (C) 2003 Josh A. Beam
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "shadow.h"
+#include "bvh.h"
+
+/* how far along a ray something has to be to count, so surfaces don't shadow themselves */
+#define RAY_EPSILON	0.0001f
+
+static struct bvh bvh;
+static long budget = SHADOW_RAY_BUDGET;
+static long rays_left = SHADOW_RAY_BUDGET;
+static unsigned long rays_cast = 0;
+
+/* each thread's sums of the shadowed lights, so each texel is saturated once */
+struct accum {
+	float *sums;
+	unsigned int size;		/* floats allocated */
+};
+
+static pthread_key_t accum_key;
+static pthread_once_t accum_once = PTHREAD_ONCE_INIT;
+
+static void
+free_accum(void *arg)
+{
+	struct accum *a = arg;
+
+	free(a->sums);
+	free(a);
+}
+
+static void
+create_accum_key()
+{
+	pthread_key_create(&accum_key, free_accum);
+}
+
+/* returns the calling thread's zeroed sums for size floats, or NULL if out of memory */
+static float *
+get_accum(unsigned int size)
+{
+	struct accum *a;
+	float *sums;
+	unsigned int i;
+
+	pthread_once(&accum_once, create_accum_key);
+	if(!(a = pthread_getspecific(accum_key))) {
+		if(!(a = calloc(1, sizeof(struct accum))))
+			return NULL;
+		pthread_setspecific(accum_key, a);
+	}
+	if(a->size < size) {
+		if(!(sums = realloc(a->sums, sizeof(float) * size)))
+			return NULL;
+		a->sums = sums;
+		a->size = size;
+	}
+
+	for(i = 0; i < size; i++)
+		a->sums[i] = 0.0f;
+	return a->sums;
+}
+
+int
+shadow_init(struct surface **surfaces, unsigned int num_surfaces)
+{
+	bvh_free(&bvh);
+	if(!bvh_build(&bvh, surfaces, num_surfaces)) {
+		fprintf(stderr, "Error: Couldn't allocate memory for shadows\n");
+		return 0;
+	}
+
+	return 1;
+}
+
+void
+shadow_shutdown()
+{
+	bvh_free(&bvh);
+}
+
+void
+shadow_set_budget(long b)
+{
+	budget = b;
+	rays_left = b;
+}
+
+void
+shadow_begin_frame()
+{
+	rays_left = budget;
+	rays_cast = 0;
+}
+
+unsigned long
+shadow_rays_cast()
+{
+	return rays_cast;
+}
+
+/*
+ * Counts n rays against this frame's budget. If use_budget is set and
+ * there aren't that many left, returns 0 without counting them. Claims
+ * without use_budget always succeed, so the caller decides what mustn't
+ * be put off; their rays still come out of what the others can have.
+ */
+static int
+claim_rays(long n, int use_budget)
+{
+	long left;
+
+	if(budget > 0) {
+		left = __sync_fetch_and_sub(&rays_left, n);
+		if(use_budget && left < n) {
+			__sync_fetch_and_add(&rays_left, n);
+			return 0;
+		}
+	}
+
+	__sync_fetch_and_add(&rays_cast, (unsigned long)n);
+	return 1;
+}
+
+/* an occluder's corner and edges, for the ray test */
+struct occluder {
+	float origin[3];
+	float s_edge[3], t_edge[3];
+};
+
+static void
+cross(const float a[3], const float b[3], float out[3])
+{
+	out[0] = a[1] * b[2] - a[2] * b[1];
+	out[1] = a[2] * b[0] - a[0] * b[2];
+	out[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+static float
+dot(const float a[3], const float b[3])
+{
+	return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+/*
+ * Returns 1 if the segment from p to p + dir passes through the
+ * parallelogram. This is the Moller-Trumbore triangle test with the
+ * limits changed to cover both triangles of the quad.
+ */
+static int
+segment_hits(const float p[3], const float dir[3], const struct occluder *o)
+{
+	float pvec[3], tvec[3], qvec[3];
+	float det, inv, u, v, t;
+
+	cross(dir, o->t_edge, pvec);
+	det = dot(o->s_edge, pvec);
+	if(det > -1e-12f && det < 1e-12f)
+		return 0;
+	inv = 1.0f / det;
+
+	tvec[0] = p[0] - o->origin[0];
+	tvec[1] = p[1] - o->origin[1];
+	tvec[2] = p[2] - o->origin[2];
+	u = dot(tvec, pvec) * inv;
+	if(u < 0.0f || u > 1.0f)
+		return 0;
+
+	cross(tvec, o->s_edge, qvec);
+	v = dot(dir, qvec) * inv;
+	if(v < 0.0f || v > 1.0f)
+		return 0;
+
+	t = dot(o->t_edge, qvec) * inv;
+	return (t > RAY_EPSILON && t < 1.0f - RAY_EPSILON);
+}
+
+static void
+make_occluder(const struct surface *surf, struct occluder *o)
+{
+	int k;
+
+	for(k = 0; k < 3; k++) {
+		o->origin[k] = surf->vertices[0][k];
+		o->s_edge[k] = surf->vertices[3][k] - surf->vertices[0][k];
+		o->t_edge[k] = surf->vertices[1][k] - surf->vertices[0][k];
+	}
+}
+
+/* returns 1 if the segment from p to p + dir passes through the node's box */
+static int
+segment_hits_box(const float p[3], const float inv_dir[3], const struct bvh_node *node)
+{
+	float t0 = 0.0f, t1 = 1.0f, near, far, tmp;
+	int k;
+
+	for(k = 0; k < 3; k++) {
+		near = (node->min[k] - p[k]) * inv_dir[k];
+		far = (node->max[k] - p[k]) * inv_dir[k];
+		if(near > far) {
+			tmp = near;
+			near = far;
+			far = tmp;
+		}
+		if(near > t0)
+			t0 = near;
+		if(far < t1)
+			t1 = far;
+		if(t0 > t1)
+			return 0;
+	}
+
+	return 1;
+}
+
+/*
+ * Walks the hierarchy for a single ray and returns the first surface
+ * found in the way, or NULL. This is used when too many surfaces could
+ * block a surface's rays for them to be tested as a list.
+ */
+static const struct surface *
+segment_blocked(const float p[3], const float dir[3], const struct surface *ignore)
+{
+	unsigned int stack[BVH_MAX_DEPTH + 1];
+	unsigned int sp = 0, i;
+	const struct bvh_node *node;
+	struct occluder o;
+	float inv_dir[3];
+	int k;
+
+	for(k = 0; k < 3; k++)
+		inv_dir[k] = dir[k] != 0.0f ? 1.0f / dir[k] : 1e30f;
+
+	stack[sp++] = 0;
+	while(sp > 0) {
+		node = &bvh.nodes[stack[--sp]];
+		if(!segment_hits_box(p, inv_dir, node))
+			continue;
+
+		if(node->count == 0) {
+			stack[sp++] = node->second;
+			stack[sp++] = (unsigned int)(node - bvh.nodes) + 1;
+			continue;
+		}
+
+		for(i = node->first; i < node->first + node->count; i++) {
+			if(bvh.items[i] == ignore)
+				continue;
+			make_occluder(bvh.items[i], &o);
+			if(segment_hits(p, dir, &o))
+				return bvh.items[i];
+		}
+	}
+
+	return NULL;
+}
+
+/* the box that every ray from surf to light is inside */
+static void
+ray_bounds(const struct surface *surf, const struct light *light, float min[3], float max[3])
+{
+	int j, k;
+
+	for(k = 0; k < 3; k++) {
+		min[k] = max[k] = light->pos[k];
+		for(j = 0; j < 4; j++) {
+			if(surf->vertices[j][k] < min[k])
+				min[k] = surf->vertices[j][k];
+			if(surf->vertices[j][k] > max[k])
+				max[k] = surf->vertices[j][k];
+		}
+	}
+}
+
+/* returns 1 if any surface other than surf could block the rays from surf to light */
+static int
+may_be_blocked(const struct surface *surf, const struct light *light)
+{
+	const struct surface *found[2];
+	float min[3], max[3];
+	unsigned int n;
+
+	ray_bounds(surf, light, min, max);
+	n = bvh_query_box(&bvh, min, max, found, 2);
+
+	return (n > 1 || (n == 1 && found[0] != surf));
+}
+
+/*
+ * Finds the surfaces that could block any ray from surf to light.
+ * Returns -1 if there are more than SHADOW_MAX_OCCLUDERS of them.
+ */
+static int
+find_occluders(const struct surface *surf, const struct light *light,
+               struct occluder *out)
+{
+	const struct surface *found[SHADOW_MAX_OCCLUDERS];
+	float min[3], max[3];
+	unsigned int i, n;
+	int count = 0;
+
+	ray_bounds(surf, light, min, max);
+	n = bvh_query_box(&bvh, min, max, found, SHADOW_MAX_OCCLUDERS);
+	if(n > SHADOW_MAX_OCCLUDERS)
+		return -1;
+
+	for(i = 0; i < n; i++) {
+		if(found[i] != surf)
+			make_occluder(found[i], &out[count++]);
+	}
+
+	return count;
+}
+
+/*
+ * Adds one light to the sums for the texels that can see it. If
+ * num_occluders is -1, each ray walks the hierarchy instead.
+ */
+static void
+add_shadowed_light(const struct surface *surf, const struct light *light,
+                   const struct occluder *occluders, int num_occluders,
+                   float *sums, unsigned int width, unsigned int height)
+{
+	float s_step[3], t_step[3], pos[3], dir[3], d, color[3];
+	const struct surface *last_hit = NULL;
+	struct occluder o;
+	unsigned int i, j, c;
+	float *out = sums;
+	int k, last = 0, blocked;
+
+	for(c = 0; c < 3; c++) {
+		s_step[c] = surf->matrix[0 + c] * surf->extents[0] / (float)width;
+		t_step[c] = surf->matrix[3 + c] * surf->extents[1] / (float)height;
+		color[c] = 255.0f * light->color[c];
+	}
+
+	for(i = 0; i < height; i++) {
+		for(c = 0; c < 3; c++)
+			pos[c] = surf->vertices[0][c] + t_step[c] * (float)i;
+
+		for(j = 0; j < width; j++, out += 3) {
+			for(c = 0; c < 3; c++)
+				dir[c] = light->pos[c] - pos[c];
+
+			/* neighbouring rays are usually blocked by the same surface, so try it first */
+			if(num_occluders < 0) {
+				if(last_hit)
+					make_occluder(last_hit, &o);
+				blocked = last_hit && segment_hits(pos, dir, &o);
+				if(!blocked && (last_hit = segment_blocked(pos, dir, surf)) != NULL)
+					blocked = 1;
+			} else {
+				blocked = num_occluders > 0 && segment_hits(pos, dir, &occluders[last]);
+				for(k = 0; k < num_occluders && !blocked; k++) {
+					if(k != last && segment_hits(pos, dir, &occluders[k])) {
+						blocked = 1;
+						last = k;
+					}
+				}
+			}
+
+			if(!blocked) {
+				d = dot(dir, dir) * 0.5f;
+				if(d < 1.0f)
+					d = 1.0f;
+				d = 1.0f / d;
+				for(c = 0; c < 3; c++)
+					out[c] += color[c] * d;
+			}
+
+			pos[0] += s_step[0];
+			pos[1] += s_step[1];
+			pos[2] += s_step[2];
+		}
+	}
+}
+
+int
+shadow_compute(const struct surface *surf, const struct light *lights,
+               unsigned int num_lights, unsigned char *data,
+               unsigned int width, unsigned int height, unsigned int pitch,
+               int use_budget)
+{
+	struct light sorted[MAX_LIGHTS];
+	struct occluder occluders[SHADOW_MAX_OCCLUDERS];
+	unsigned int i, j, c, front = 0, back = num_lights;
+	unsigned char *out;
+	float *sums, *sum, value;
+	int n;
+
+	if(num_lights == 0) {
+		lightmap_compute(surf, lights, 0, data, width, height, pitch);
+		return 1;
+	}
+
+	/*
+	 * Lights with nothing in the way go to the front and through the
+	 * normal texel loop together; the rest go to the back.
+	 */
+	for(i = 0; i < num_lights; i++) {
+		if(!may_be_blocked(surf, &lights[i]))
+			sorted[front++] = lights[i];
+		else
+			sorted[--back] = lights[i];
+	}
+	if(back == num_lights) {
+		lightmap_compute(surf, sorted, front, data, width, height, pitch);
+		return 1;
+	}
+
+	if(!claim_rays((long)width * height * (num_lights - back), use_budget))
+		return 0;
+	if(!(sums = get_accum(width * height * 3))) {
+		fprintf(stderr, "Error: Couldn't allocate memory for shadows\n");
+		return 0;
+	}
+	lightmap_compute(surf, sorted, front, data, width, height, pitch);
+
+	/* the shadowed lights are summed, then added to each texel and saturated once */
+	for(i = back; i < num_lights; i++) {
+		n = find_occluders(surf, &sorted[i], occluders);
+		add_shadowed_light(surf, &sorted[i], occluders, n, sums, width, height);
+	}
+	for(i = 0, sum = sums; i < height; i++) {
+		out = data + i * pitch;
+		for(j = 0; j < width * 3; j += 3, sum += 3) {
+			for(c = 0; c < 3; c++) {
+				value = (float)out[j + c] + sum[c];
+				out[j + c] = (unsigned char)(value > 255.0f ? 255.0f : value);
+			}
+		}
+	}
+
+	return 1;
+}
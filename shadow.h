@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2003 Josh A. Beam
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __SHADOW_H__
+#define __SHADOW_H__
+
+#include "lightmap.h"
+
+/*
+ * Shadowed lightmaps. A ray is cast from each texel to each light, and
+ * the light doesn't reach the texel if any other surface is in the way.
+ * The rays from one surface to one light are handled together: a single
+ * walk of the bounding volume hierarchy finds the surfaces that could be
+ * in the way of any of them, and only those are tested against each ray.
+ * Lights with nothing in the way use the normal texel loop.
+ */
+
+/* default number of shadow rays allowed between calls to shadow_begin_frame() */
+#define SHADOW_RAY_BUDGET	(1L << 20)
+
+/* at most this many surfaces can block the rays from one surface to one light */
+#define SHADOW_MAX_OCCLUDERS	256
+
+/* builds the hierarchy for the surfaces that can cast shadows; returns 0 on failure */
+int shadow_init(struct surface **surfaces, unsigned int num_surfaces);
+void shadow_shutdown();
+
+/* budget is the number of rays per frame, or 0 for no limit */
+void shadow_set_budget(long budget);
+void shadow_begin_frame();
+
+/* returns the number of rays cast since shadow_begin_frame() */
+unsigned long shadow_rays_cast();
+
+/*
+ * Computes surf's lightmap like lightmap_compute(), with shadows. If
+ * use_budget is set and this frame's budget doesn't have the rays it
+ * needs, 0 is returned without touching data, so the last lightmap can
+ * be kept until a later frame; otherwise returns 1. Without use_budget
+ * the rays are always cast, but still come out of the frame's budget.
+ */
+int shadow_compute(const struct surface *surf, const struct light *lights,
+                   unsigned int num_lights, unsigned char *data,
+                   unsigned int width, unsigned int height, unsigned int pitch,
+                   int use_budget);
+
+#endif /* __SHADOW_H__ */
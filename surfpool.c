@@ -0,0 +1,197 @@
+/*
+ * Copyright (C) 2003 Josh A. Beam
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "surfpool.h"
+
+/*
+ * Capacity is limited to what fits in the slot part of a handle, less
+ * one so that SURFACE_HANDLE_NONE's slot is never used.
+ */
+#define SLOT_BITS	24
+#define SLOT_MASK	((1U << SLOT_BITS) - 1)
+#define MAX_GENERATION	0xff
+
+int
+surfpool_init(struct surface_pool *pool, unsigned int capacity)
+{
+	unsigned int i;
+
+	memset(pool, 0, sizeof(struct surface_pool));
+	if(capacity < 1)
+		capacity = 1;
+	if(capacity > SLOT_MASK)
+		return 0;
+
+	pool->records = malloc(sizeof(struct surface) * capacity);
+	pool->positions = malloc(sizeof(float) * 12 * capacity);
+	pool->bases = malloc(sizeof(float) * 9 * capacity);
+	pool->extents = malloc(sizeof(float) * 2 * capacity);
+	pool->bounds = malloc(sizeof(float) * 4 * capacity);
+	pool->lightmaps = malloc(sizeof(struct surface_lightmap) * capacity);
+	pool->flags = malloc(capacity);
+	pool->waits = malloc(sizeof(unsigned int) * capacity);
+	pool->priorities = malloc(sizeof(float) * capacity);
+	pool->changes = malloc(sizeof(float) * capacity);
+	pool->handles = malloc(sizeof(surface_handle) * capacity);
+	pool->slots = malloc(sizeof(unsigned int) * capacity);
+	pool->generations = calloc(capacity, 1);
+	if(!pool->records || !pool->positions || !pool->bases || !pool->extents ||
+	   !pool->bounds || !pool->lightmaps || !pool->flags || !pool->waits ||
+	   !pool->priorities || !pool->changes || !pool->handles || !pool->slots || !pool->generations) {
+		surfpool_free(pool);
+		return 0;
+	}
+
+	pool->capacity = capacity;
+	for(i = 0; i < capacity; i++)
+		pool->slots[i] = i + 1;
+	pool->free_slot = 0;
+
+	return 1;
+}
+
+void
+surfpool_free(struct surface_pool *pool)
+{
+	free(pool->records);
+	free(pool->positions);
+	free(pool->bases);
+	free(pool->extents);
+	free(pool->bounds);
+	free(pool->lightmaps);
+	free(pool->flags);
+	free(pool->waits);
+	free(pool->priorities);
+	free(pool->changes);
+	free(pool->handles);
+	free(pool->slots);
+	free(pool->generations);
+	memset(pool, 0, sizeof(struct surface_pool));
+}
+
+/* points record i at row i of the arrays */
+static void
+bind_record(struct surface_pool *pool, unsigned int i)
+{
+	struct surface *surf = &pool->records[i];
+
+	surf->vertices = pool->positions[i];
+	surf->matrix = pool->bases[i];
+	surf->extents = pool->extents[i];
+	surf->bounds = pool->bounds[i];
+	surf->lightmap = &pool->lightmaps[i];
+}
+
+int
+surfpool_alloc(struct surface_pool *pool, unsigned int n, surface_handle *handles)
+{
+	unsigned int first = pool->count, i, slot;
+
+	if(n > pool->capacity - pool->retired - pool->count)
+		return -1;
+
+	for(i = first; i < first + n; i++) {
+		slot = pool->free_slot;
+		pool->free_slot = pool->slots[slot];
+		pool->slots[slot] = i;
+		pool->handles[i] = ((unsigned int)pool->generations[slot] << SLOT_BITS) | slot;
+		if(handles)
+			*handles++ = pool->handles[i];
+
+		bind_record(pool, i);
+		pool->flags[i] = SURFACE_DIRTY;
+		pool->waits[i] = 0;
+		pool->priorities[i] = 0.0f;
+		pool->changes[i] = 0.0f;
+	}
+	pool->count += n;
+
+	return (int)first;
+}
+
+int
+surfpool_index(const struct surface_pool *pool, surface_handle handle)
+{
+	unsigned int slot = handle & SLOT_MASK, index;
+
+	if(slot >= pool->capacity)
+		return -1;
+
+	index = pool->slots[slot];
+	if(index >= pool->count || pool->handles[index] != handle)
+		return -1;
+
+	return (int)index;
+}
+
+void
+surfpool_remove(struct surface_pool *pool, surface_handle handle)
+{
+	int index = surfpool_index(pool, handle);
+	unsigned int last, slot = handle & SLOT_MASK;
+
+	if(index < 0)
+		return;
+	if(pool->append_only) {
+		fprintf(stderr, "Error: Can't remove surfaces from an append-only pool\n");
+		return;
+	}
+
+	/* move the last surface into the hole */
+	last = pool->count - 1;
+	if((unsigned int)index != last) {
+		pool->records[index] = pool->records[last];
+		bind_record(pool, index);
+		memcpy(pool->positions[index], pool->positions[last], sizeof(pool->positions[index]));
+		memcpy(pool->bases[index], pool->bases[last], sizeof(pool->bases[index]));
+		memcpy(pool->extents[index], pool->extents[last], sizeof(pool->extents[index]));
+		memcpy(pool->bounds[index], pool->bounds[last], sizeof(pool->bounds[index]));
+		pool->lightmaps[index] = pool->lightmaps[last];
+		pool->flags[index] = pool->flags[last];
+		pool->waits[index] = pool->waits[last];
+		pool->priorities[index] = pool->priorities[last];
+		pool->changes[index] = pool->changes[last];
+		pool->handles[index] = pool->handles[last];
+		pool->slots[pool->handles[index] & SLOT_MASK] = index;
+	}
+	pool->count--;
+
+	/*
+	 * A new generation makes copies of the old handle stale. A slot whose
+	 * generations have all been used is retired rather than reused, so a
+	 * handle that old can never match again.
+	 */
+	if(pool->generations[slot] == MAX_GENERATION) {
+		pool->slots[slot] = pool->capacity;
+		pool->retired++;
+		return;
+	}
+	pool->generations[slot]++;
+	pool->slots[slot] = pool->free_slot;
+	pool->free_slot = slot;
+}
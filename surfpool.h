@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2003 Josh A. Beam
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __SURFPOOL_H__
+#define __SURFPOOL_H__
+
+#include "lightmap.h"
+
+/*
+ * Surfaces stored as a structure of arrays. Each field that the passes
+ * over every surface read (corners, basis, extents, bounds, lightmap
+ * placement, flags and scheduling state) has an array of its own, so a
+ * pass streams through only the fields it needs. The rest of each
+ * surface is in records, whose pointers lead to the surface's row of
+ * the arrays, so code that takes a struct surface still works on it and
+ * there is only one copy of everything.
+ *
+ * Surfaces are addressed by handles, which stay valid until the surface
+ * is removed. Removing one moves the last surface into its place, so
+ * the index and record of that surface change; handles don't.
+ */
+
+typedef unsigned int surface_handle;
+
+/* never a valid handle: capacity is kept below the largest slot */
+#define SURFACE_HANDLE_NONE	0xffffffffU
+
+/* flags */
+#define SURFACE_CULLED		0x01	/* outside the view or facing away this frame */
+#define SURFACE_PENDING		0x02	/* lightmap needs recomputing, this frame or a later one */
+#define SURFACE_DIRTY		0x04	/* recompute the lightmap even if no light changed */
+#define SURFACE_CHANGED		0x08	/* lightmap recomputed, needs to be uploaded */
+#define SURFACE_RESIZED		0x10	/* level of detail changed, texture coordinates need updating */
+
+struct surface_pool {
+	unsigned int count, capacity;
+
+	/*
+	 * Set for pools whose indexes or record pointers are kept elsewhere,
+	 * such as by the light grid, BVH and vertex array of the scene.
+	 * surfpool_remove() refuses to move surfaces in them.
+	 */
+	int append_only;
+
+	/* index i of each array is the i-th surface */
+	struct surface *records;
+	float (*positions)[4][3];
+	float (*bases)[9];
+	float (*extents)[2];
+	float (*bounds)[4];
+	struct surface_lightmap *lightmaps;
+	unsigned char *flags;
+	unsigned int *waits;		/* frames a pending recompute has been put off */
+	float *priorities;		/* order of pending recomputes */
+	float *changes;			/* largest light change not yet in the lightmap, in texel steps */
+
+	/* handles are a slot number and a generation; slots map to indexes */
+	surface_handle *handles;	/* handle of each index */
+	unsigned int *slots;		/* index of each slot, or the next free slot */
+	unsigned char *generations;
+	unsigned int free_slot;
+	unsigned int retired;		/* slots whose generations ran out */
+};
+
+/* returns 0 if the arrays couldn't be allocated */
+int surfpool_init(struct surface_pool *pool, unsigned int capacity);
+void surfpool_free(struct surface_pool *pool);
+
+/*
+ * Adds n surfaces at the end and returns the index of the first, or -1
+ * if there isn't room. If handles isn't NULL their handles are stored
+ * in it. The new records point at their rows and are flagged
+ * SURFACE_DIRTY; fill them in with surface_init() or surface_reset().
+ */
+int surfpool_alloc(struct surface_pool *pool, unsigned int n, surface_handle *handles);
+
+/* moves the last surface into the removed one's place; see append_only */
+void surfpool_remove(struct surface_pool *pool, surface_handle handle);
+
+/* returns the index of a handle's surface, or -1 if it has been removed */
+int surfpool_index(const struct surface_pool *pool, surface_handle handle);
+
+#endif /* __SURFPOOL_H__ */
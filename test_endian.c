@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2003 Josh A. Beam
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Checks the byte swaps a big-endian host reads files with, which a
+ * little-endian host never runs otherwise. Known buffers are swapped
+ * with swap_16_array() and swap_32_array() at every length and offset
+ * around the vector widths and compared with a byte at a time swap.
+ * Exits with 1 if any differ.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "my_endian.h"
+
+#define TEST_BYTES	256
+
+/* the reference: reverse each size byte value */
+static void
+swap_reference(unsigned char *p, unsigned long count, unsigned int size)
+{
+	unsigned char tmp;
+	unsigned long i;
+	unsigned int j;
+
+	for(i = 0; i < count; i++, p += size) {
+		for(j = 0; j < size / 2; j++) {
+			tmp = p[j];
+			p[j] = p[size - 1 - j];
+			p[size - 1 - j] = tmp;
+		}
+	}
+}
+
+/* returns the number of lengths and offsets that didn't match the reference */
+static int
+check_swap(unsigned int size)
+{
+	unsigned char data[TEST_BYTES + 16], ref[TEST_BYTES + 16];
+	unsigned long count;
+	unsigned int offset, i;
+	int failures = 0;
+
+	for(offset = 0; offset < 16; offset++) {
+		for(count = 0; count * size + offset <= TEST_BYTES; count++) {
+			for(i = 0; i < sizeof(data); i++)
+				data[i] = ref[i] = (unsigned char)(i * 7 + 1);
+
+			if(size == 2)
+				swap_16_array(data + offset, count);
+			else
+				swap_32_array(data + offset, count);
+			swap_reference(ref + offset, count, size);
+
+			if(memcmp(data, ref, sizeof(data)) != 0) {
+				printf("swap_%u_array: wrong at offset %u, %lu values\n", size * 8, offset, count);
+				failures++;
+			}
+		}
+	}
+
+	return failures;
+}
+
+int
+main()
+{
+	static const unsigned char le[] = { 0x04, 0x03, 0x02, 0x01, 0x02, 0x01 };
+	unsigned char buf[sizeof(le)];
+	uint32_t u;
+	uint16_t s;
+	int failures = 0;
+
+	if(sizeof(int32_t) != 4 || sizeof(uint32_t) != 4 || sizeof(int16_t) != 2 || sizeof(uint16_t) != 2) {
+		printf("fixed width types have the wrong sizes\n");
+		return 1;
+	}
+
+	failures += check_swap(2);
+	failures += check_swap(4);
+
+	/* a known little-endian value, read as a big-endian host would */
+	memcpy(buf, le, sizeof(le));
+	swap_32_array(buf, 1);
+	swap_16_array(buf + 4, 1);
+	u = (uint32_t)buf[0] << 24 | (uint32_t)buf[1] << 16 | (uint32_t)buf[2] << 8 | buf[3];
+	s = (uint16_t)(buf[4] << 8 | buf[5]);
+	if(u != 0x01020304UL || s != 0x0102) {
+		printf("known values swapped to %08lx and %04x\n", (unsigned long)u, (unsigned int)s);
+		failures++;
+	}
+
+	/* and the native conversion gives the value on this host */
+	memcpy(&u, le, 4);
+	memcpy(&s, le + 4, 2);
+	if(le_to_native_uint(u) != 0x01020304UL || le_to_native_ushort(s) != 0x0102) {
+		printf("le_to_native gives %08lx and %04x\n",
+		       (unsigned long)le_to_native_uint(u), (unsigned int)le_to_native_ushort(s));
+		failures++;
+	}
+
+	printf("byte swaps: %s\n", failures ? "FAILED" : "ok");
+	return failures ? 1 : 0;
+}
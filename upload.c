@@ -0,0 +1,278 @@
+/*
+ * Copyright (C) 2003 Josh A. Beam
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define GL_GLEXT_PROTOTYPES
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <GL/gl.h>
+#include <GL/glext.h>
+#include "upload.h"
+#include "atlas.h"
+#include "prof.h"
+
+extern int have_extension(const char *name);
+
+/*
+ * How long to wait for the GPU to finish reading a buffer, in
+ * nanoseconds. It only has to wait if the GPU is UPLOAD_RING_SIZE frames
+ * behind; past this the frame uploads from client memory instead.
+ */
+#define UPLOAD_FENCE_TIMEOUT	100000000
+
+struct upload_buffer {
+	unsigned int pbo;
+	unsigned int size;		/* bytes allocated */
+	GLsync fence;			/* set once the textures have been updated from it */
+};
+
+static struct upload_buffer ring[UPLOAD_RING_SIZE];
+static unsigned int next_buffer = 0;
+static int mode = UPLOAD_PBO;
+static int checked = 0;		/* extensions have been looked for */
+static int have_sync = 0;	/* fences and unsynchronized mapping are available */
+static int mapped = 0;		/* the next buffer is mapped by upload_begin() */
+
+/* texture updates from the mapped buffer */
+struct queued_update {
+	int page;
+	unsigned int x, y, width, height;
+	unsigned int offset;		/* into the buffer */
+};
+
+static struct queued_update *queued = NULL;
+static unsigned int num_queued = 0, max_queued = 0;
+
+static void
+create_texture(struct atlas_page *page)
+{
+	glGenTextures(1, &page->tex);
+	glBindTexture(GL_TEXTURE_2D, page->tex);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexImage2D(GL_TEXTURE_2D, 0, 3, ATLAS_PAGE_SIZE, ATLAS_PAGE_SIZE, 0, GL_RGB, GL_UNSIGNED_BYTE, page->data);
+	prof_count(PROF_UPLOAD_BYTES, ATLAS_PAGE_SIZE * ATLAS_PAGE_SIZE * 3);
+}
+
+/* updates a rectangle of a page from pixels, a pointer or a buffer offset */
+static void
+update_texture(struct atlas_page *page, unsigned int x, unsigned int y,
+               unsigned int width, unsigned int height, const unsigned char *pixels)
+{
+	glBindTexture(GL_TEXTURE_2D, page->tex);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, width, height, GL_RGB, GL_UNSIGNED_BYTE, pixels);
+	prof_count(PROF_UPLOAD_BYTES, width * height * 3);
+}
+
+/* returns a pointer to write size bytes into b, or NULL if it can't be mapped */
+static unsigned char *
+map_buffer(struct upload_buffer *b, unsigned int size)
+{
+	GLenum status;
+
+	if(b->fence) {
+		status = glClientWaitSync(b->fence, GL_SYNC_FLUSH_COMMANDS_BIT, UPLOAD_FENCE_TIMEOUT);
+		if(status == GL_TIMEOUT_EXPIRED) {
+			/* leave the fence; the next frame tries the next buffer */
+			fprintf(stderr, "Warning: Upload buffer still in use after %d ms, uploading from client memory\n",
+			        UPLOAD_FENCE_TIMEOUT / 1000000);
+			next_buffer = (next_buffer + 1) % UPLOAD_RING_SIZE;
+			return NULL;
+		} else if(status == GL_WAIT_FAILED) {
+			/* nothing will signal it, so the buffer can't be trusted either */
+			fprintf(stderr, "Error: Waiting for an upload buffer failed, uploading from client memory\n");
+			glDeleteSync(b->fence);
+			b->fence = 0;
+			glDeleteBuffersARB(1, &b->pbo);
+			b->pbo = 0;
+			b->size = 0;
+			return NULL;
+		}
+		glDeleteSync(b->fence);
+		b->fence = 0;
+	}
+
+	if(!b->pbo)
+		glGenBuffersARB(1, &b->pbo);
+	glBindBufferARB(GL_PIXEL_UNPACK_BUFFER_ARB, b->pbo);
+
+	if(size > b->size) {
+		glBufferDataARB(GL_PIXEL_UNPACK_BUFFER_ARB, size, NULL, GL_STREAM_DRAW_ARB);
+		b->size = size;
+	} else if(have_sync) {
+		/* the fence has passed, so the driver doesn't need to check */
+		return glMapBufferRange(GL_PIXEL_UNPACK_BUFFER_ARB, 0, size,
+		                        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+	} else {
+		/* no fences; orphan the old storage instead of waiting for it */
+		glBufferDataARB(GL_PIXEL_UNPACK_BUFFER_ARB, b->size, NULL, GL_STREAM_DRAW_ARB);
+	}
+
+	return glMapBufferARB(GL_PIXEL_UNPACK_BUFFER_ARB, GL_WRITE_ONLY_ARB);
+}
+
+unsigned char *
+upload_begin(unsigned int size)
+{
+	unsigned char *dst;
+
+	if(!checked)
+		upload_set_mode(mode);
+	if(mode != UPLOAD_PBO || size == 0)
+		return NULL;
+
+	if(!(dst = map_buffer(&ring[next_buffer], size))) {
+		glBindBufferARB(GL_PIXEL_UNPACK_BUFFER_ARB, 0);
+		return NULL;
+	}
+	glBindBufferARB(GL_PIXEL_UNPACK_BUFFER_ARB, 0);
+	mapped = 1;
+	num_queued = 0;
+
+	return dst;
+}
+
+int
+upload_add(int page, unsigned int x, unsigned int y,
+           unsigned int width, unsigned int height, unsigned int offset)
+{
+	struct queued_update *q;
+	unsigned int new_max;
+
+	if(num_queued == max_queued) {
+		new_max = max_queued ? max_queued * 2 : 256;
+		q = realloc(queued, sizeof(struct queued_update) * new_max);
+		if(!q) {
+			fprintf(stderr, "Error: Couldn't allocate memory for lightmap uploads\n");
+			return 0;
+		}
+		queued = q;
+		max_queued = new_max;
+	}
+
+	q = &queued[num_queued++];
+	q->page = page;
+	q->x = x;
+	q->y = y;
+	q->width = width;
+	q->height = height;
+	q->offset = offset;
+
+	return 1;
+}
+
+/* updates the textures from the mapped buffer; returns 0 if its contents were lost */
+static int
+finish_pbo()
+{
+	struct upload_buffer *b = &ring[next_buffer];
+	const struct queued_update *q;
+	unsigned int i;
+
+	mapped = 0;
+	glBindBufferARB(GL_PIXEL_UNPACK_BUFFER_ARB, b->pbo);
+	if(!glUnmapBufferARB(GL_PIXEL_UNPACK_BUFFER_ARB)) {
+		/* the contents were lost, e.g. on a mode switch */
+		glBindBufferARB(GL_PIXEL_UNPACK_BUFFER_ARB, 0);
+		return 0;
+	}
+
+	for(i = 0; i < num_queued; i++) {
+		q = &queued[i];
+		update_texture(atlas_get_page(q->page), q->x, q->y, q->width, q->height,
+		               (const unsigned char *)0 + q->offset);
+	}
+	glBindBufferARB(GL_PIXEL_UNPACK_BUFFER_ARB, 0);
+
+	if(have_sync)
+		b->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	next_buffer = (next_buffer + 1) % UPLOAD_RING_SIZE;
+
+	return 1;
+}
+
+int
+upload_lightmaps()
+{
+	struct atlas_page *page;
+	unsigned int x, y, width, height;
+	int i, ok = 1;
+
+	if(!checked)
+		upload_set_mode(mode);
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	/* a new page is uploaded whole */
+	for(i = 0; i < atlas_num_pages(); i++) {
+		page = atlas_get_page(i);
+		if(page->tex == 0) {
+			create_texture(page);
+			atlas_clear_dirty(page);
+		}
+	}
+
+	if(mapped)
+		ok = finish_pbo();
+
+	/* anything computed into the pages, picking each rectangle out of the full rows */
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, ATLAS_PAGE_SIZE);
+	for(i = 0; i < atlas_num_pages(); i++) {
+		page = atlas_get_page(i);
+		for(y = 0; atlas_next_dirty(page, &x, &y, &width, &height); y += height)
+			update_texture(page, x, y, width, height, page->data + (y * ATLAS_PAGE_SIZE + x) * 3);
+		atlas_clear_dirty(page);
+	}
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+
+	return ok;
+}
+
+int
+upload_set_mode(int m)
+{
+	mode = m;
+
+	if(!checked) {
+		checked = 1;
+		have_sync = have_extension("GL_ARB_sync") && have_extension("GL_ARB_map_buffer_range");
+	}
+
+	if(mode == UPLOAD_PBO && !have_extension("GL_ARB_pixel_buffer_object")) {
+		fprintf(stderr, "Pixel buffer objects aren't supported, uploading from client memory\n");
+		mode = UPLOAD_CLIENT;
+	}
+
+	return mode;
+}
+
+int
+upload_mode()
+{
+	return mode;
+}
+
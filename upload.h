@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2003 Josh A. Beam
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __UPLOAD_H__
+#define __UPLOAD_H__
+
+/*
+ * Uploads changed lightmaps. With pixel buffer objects, lightmaps are
+ * computed straight into one of a ring of mapped buffers and the
+ * textures are updated from there, so there is no copy on the CPU and
+ * the driver can return immediately and copy to the GPU while the next
+ * frame's lightmaps are computed. A fence on each buffer keeps it from
+ * being rewritten before the GPU has read it. Otherwise lightmaps are
+ * computed into the atlas pages and their dirty rectangles uploaded
+ * from client memory.
+ */
+
+#define UPLOAD_CLIENT		0	/* straight from client memory, always available */
+#define UPLOAD_PBO		1
+
+#define UPLOAD_RING_SIZE	3
+
+/*
+ * Maps the next buffer in the ring with room for size bytes of
+ * lightmaps, to be computed straight into it. Returns NULL if they
+ * should be computed into the atlas pages instead, in UPLOAD_CLIENT mode
+ * or if no buffer could be mapped. Call from the GL thread.
+ */
+unsigned char *upload_begin(unsigned int size);
+
+/*
+ * Queues updating the width x height rectangle at x, y of an atlas page
+ * from the tightly packed lightmap at offset in the mapped buffer.
+ * Returns 0 if it couldn't be queued.
+ */
+int upload_add(int page, unsigned int x, unsigned int y,
+                unsigned int width, unsigned int height, unsigned int offset);
+
+/*
+ * Creates textures for new pages, unmaps the buffer from upload_begin()
+ * and updates the textures from it, and uploads every page's dirty
+ * rectangles. Returns 0 if the mapped buffer's contents were lost, in
+ * which case the lightmaps written to it need computing again.
+ */
+int upload_lightmaps();
+
+/* returns the mode actually in use, which falls back to UPLOAD_CLIENT */
+int upload_set_mode(int mode);
+int upload_mode();
+
+#endif /* __UPLOAD_H__ */